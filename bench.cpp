@@ -0,0 +1,457 @@
+// Offline benchmarks from recorded clips and sample JPEGs, no camera needed.
+//
+//   bench [--iterations N] [--frames N] [--config config/site.json] [--json out.json] <clip.h264|clip.ts|image.jpg>...
+//       decodes each input, then times every analysis/encode stage on the decoded frames
+//   bench --replay <clip.h264> [--cycles N] [--config config/site.json] [--json out.json]
+//       runs the full monitorCam() pipeline on the clip against a mocked /ctrl camera API
+//   bench --stale-layout <clip.h264> [--config config/site.json] [--json out.json]
+//       checks that a stream cache which no longer decodes is dropped within two one-shot captures, exit 1 if not
+//
+// Results are JSON (stdout or --json) so runs can be diffed.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cmath>
+#include <filesystem>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <zcamController.h>
+#include <overlays.h>
+#include <focus.h>
+#include <frameAnalyzer.h>
+#include <someFFMpeg.h>
+#include <someLogger.h>
+#include <someMetrics.h>
+#include <someUploader.h>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+const string SCRATCH = "/tmp/zcam-bench/";
+
+// Friend of ZCAMController, so the private analysis stages can be timed on their own
+class ZCAMBench {
+public:
+    static ExposureMetrics analyzeExposure(ZCAMController& controller, const AVFrame *frame) {
+        return controller.analyzeExposure(frame);
+    }
+    static bool monitorCam(ZCAMController& controller) {
+        return controller.monitorCam();
+    }
+};
+
+struct Stage {
+    someHistogram histogram;
+    int failures = 0;               // timed runs that produced nothing, a fast failure is not a fast stage
+    explicit Stage(const string& name) : histogram(name) {}
+    json summary() {
+        json result = histogram.summary();
+        double mean = result["mean_ms"].get<double>();
+        result["per_second"] = mean > 0 ? round(1000.0 / mean * 10) / 10 : 0.0;
+        result["failures"] = failures;
+        return result;
+    }
+};
+
+// Any libavformat input, decoded through its own codec parameters - JPEGs come back as one frame
+static vector<AVFrame*> loadFrames(const string& path, const someDecoderOptions& options, int max_frames, Stage& decode) {
+
+    vector<AVFrame*> frames;
+    AVFormatContext *format_ctx = nullptr;
+    if (avformat_open_input(&format_ctx, path.c_str(), nullptr, nullptr) < 0) return frames;
+
+    AVCodecContext *codec_ctx = nullptr;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+
+    int stream = -1;
+    if (avformat_find_stream_info(format_ctx, nullptr) >= 0)
+        stream = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+
+    // Same decoder setup as ZCAM, so config["decoder"] threading shows up in the decode stage
+    if (stream >= 0 && (codec_ctx = someFFMpeg::openDecoder(format_ctx->streams[stream]->codecpar, options))) {
+
+        auto keep = [&]() {
+            if (static_cast<int>(frames.size()) < max_frames) frames.push_back(av_frame_clone(frame));
+            av_frame_unref(frame);
+        };
+
+        while (av_read_frame(format_ctx, packet) >= 0) {
+            if (packet->stream_index == stream) {
+                someTimer timer(decode.histogram);
+                bool decoded = avcodec_send_packet(codec_ctx, packet) >= 0 && avcodec_receive_frame(codec_ctx, frame) >= 0;
+                timer.stop();
+                if (decoded) keep();
+            }
+            av_packet_unref(packet);
+        }
+        // Frames still buffered in the decoder
+        avcodec_send_packet(codec_ctx, nullptr);
+        while (avcodec_receive_frame(codec_ctx, frame) >= 0) keep();
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codec_ctx);
+    avformat_close_input(&format_ctx);
+    return frames;
+}
+
+static json baseConfig(const string& path) {
+    json config = path.empty() ? json::object() : someLogger::loadConfig(path);
+    config["files"] = SCRATCH;
+    config["host"] = "bench";
+    config["server"] = "127.0.0.1";
+    config["cameras"] = {"bench"};
+    config["ipaddr"] = {"127.0.0.1"};
+    config["start_hour"] = 0;
+    config["end_hour"] = 24;
+    return config;
+}
+
+static json runStages(const vector<string>& inputs, const string& config_path, int iterations, int max_frames) {
+
+    json config = baseConfig(config_path);
+    ZCAMController controller(config, 0);
+
+    Stage decode("decode");
+    Stage exposure("analyzeExposure");
+    Stage focus_grid("focus.grid");
+    Stage fused("analyzer.analyze");
+    Stage overlay("overlay.processFrame");
+    Stage composite("overlay.compositeFrame");
+    Stage encode("encodeJPEG");
+    Stage save("saveAVFrameAsJPEG");
+    vector<unique_ptr<Stage>> focus;
+    const char *method_names[] = {"focus.laplacian", "focus.sobel", "focus.brennan", "focus.tenengrad"};
+    for (auto name : method_names) focus.emplace_back(new Stage(name));
+
+    json jinputs = json::array();
+    Focus meter;
+    FrameAnalyzer analyzer(config);
+
+    for (auto& input : inputs) {
+
+        auto frames = loadFrames(input, someFFMpeg::decoderOptions(config), max_frames, decode);
+        json jinput;
+        jinput["path"] = input;
+        jinput["frames"] = frames.size();
+        if (!frames.empty()) {
+            jinput["width"] = frames[0]->width;
+            jinput["height"] = frames[0]->height;
+            jinput["format"] = av_get_pix_fmt_name(static_cast<AVPixelFormat>(frames[0]->format));
+        }
+        jinputs.push_back(jinput);
+        if (frames.empty()) continue;
+
+        FrameOverlayProcessor processor(frames[0]->width, frames[0]->height, static_cast<AVPixelFormat>(frames[0]->format));
+        processor.setCaptionText("bench " + fs::path(input).filename().string());
+        processor.setBox(100, 100, 400, 300);
+        for (int i = 0; i < 16; i++)
+            processor.setGridText({(i % 4) * frames[0]->width / 4 + 10, (i / 4) * frames[0]->height / 4 + 10, 100.0 * i, to_string(100 * i)});
+
+        for (int i = 0; i < iterations; i++) {
+            AVFrame *frame = frames[i % frames.size()];
+
+            {
+                someTimer timer(exposure.histogram);
+                ZCAMBench::analyzeExposure(controller, frame);
+            }
+
+            for (int m = 0; m < 4; m++) {
+                someTimer timer(focus[m]->histogram);
+                meter.measure(frame, static_cast<Focus::Method>(m));
+            }
+
+            {
+                someTimer timer(focus_grid.histogram);
+                Focus::grid(frame, FocusGrid());
+            }
+
+            // Exposure, white balance and sharpness in one pass - compare with the separate stages above
+            {
+                someTimer timer(fused.histogram);
+                analyzer.analyze(frame);
+            }
+
+            {
+                someTimer timer(overlay.histogram);
+                AVFrame *output = processor.processFrame(frame);
+                timer.stop();
+                if (output) av_frame_free(&output);
+            }
+
+            AVFrame *copy = av_frame_clone(frame);
+            if (copy) {
+                someTimer timer(composite.histogram);
+                processor.compositeFrame(copy);
+                timer.stop();
+                av_frame_free(&copy);
+            }
+
+            {
+                vector<uint8_t> jpeg;
+                someTimer timer(encode.histogram);
+                if (!someFFMpeg::encodeJPEG(frame, 100, jpeg)) encode.failures++;
+            }
+
+            {
+                someTimer timer(save.histogram);
+                if (!someFFMpeg::saveAVFrameAsJPEG(frame, SCRATCH + "bench.JPG", 100)) save.failures++;
+            }
+        }
+
+        for (auto frame : frames) av_frame_free(&frame);
+    }
+
+    json result;
+    result["mode"] = "stages";
+    result["iterations"] = iterations;
+    result["inputs"] = jinputs;
+    json jstages;
+    for (Stage *stage : {&decode, &exposure, &focus_grid, &fused, &overlay, &composite, &encode, &save})
+        if (stage->histogram.count() > 0) jstages[stage->histogram.name] = stage->summary();
+    for (auto& stage : focus)
+        if (stage->histogram.count() > 0) jstages[stage->histogram.name] = stage->summary();
+    result["stages"] = jstages;
+    return result;
+}
+
+// Just enough of the camera's /ctrl API for readCurrentSettings() and applySetting()
+class MockCamera {
+
+    net::io_context ioc;
+    tcp::acceptor acceptor{ioc, {net::ip::make_address("127.0.0.1"), 0}};
+    thread server;
+    atomic<bool> running{true};
+    mutex state_mutex;
+    mutex connections_mutex;
+    vector<shared_ptr<tcp::socket>> sockets;
+    vector<thread> connections;
+    string iso = "1000";
+    string iris = "10";
+
+    string answer(const string& target) {
+        lock_guard<mutex> lock(state_mutex);
+        json body;
+        body["code"] = 0;
+        if (target == "/ctrl/get?k=iso") {
+            body["value"] = iso;
+            body["opts"] = {"400", "500", "640", "800", "1000", "1250", "1600", "2000", "2500", "3200", "4000", "5000", "6400"};
+        } else if (target == "/ctrl/get?k=iris") {
+            body["value"] = iris;
+            body["opts"] = {"8.0", "9.0", "10", "11"};
+        } else if (target == "/ctrl/temperature") {
+            body["msg"] = "42";
+        } else if (target.rfind("/ctrl/set?", 0) == 0) {
+            sets++;
+            auto eq = target.find('=');
+            string key = target.substr(10, eq - 10);
+            if (key == "iso") iso = target.substr(eq + 1);
+            else if (key == "iris") iris = target.substr(eq + 1);
+        } else {
+            body["code"] = -1;
+        }
+        return body.dump();
+    }
+
+    // Each connection on a thread of its own, a client holding one open must not block the next
+    void serve() {
+        while (running) {
+            auto socket = make_shared<tcp::socket>(ioc);
+            beast::error_code ec;
+            acceptor.accept(*socket, ec);
+            if (ec || !running) break;
+            lock_guard<mutex> lock(connections_mutex);
+            sockets.push_back(socket);
+            connections.emplace_back(&MockCamera::session, this, socket);
+        }
+    }
+
+    // Keep-alive, like the real camera, so ZCAMControl's connection reuse is exercised
+    void session(shared_ptr<tcp::socket> socket) {
+        beast::flat_buffer buffer;
+        beast::error_code ec;
+        while (true) {
+            http::request<http::empty_body> req;
+            http::read(*socket, buffer, req, ec);
+            if (ec) break;
+            http::response<http::string_body> res{http::status::ok, req.version()};
+            res.set(http::field::content_type, "application/json");
+            res.keep_alive(req.keep_alive());
+            res.body() = answer(string(req.target()));
+            res.prepare_payload();
+            http::write(*socket, res, ec);
+            if (ec || !req.keep_alive()) break;
+        }
+    }
+
+public:
+    atomic<int> sets{0};
+
+    MockCamera() : server(&MockCamera::serve, this) {}
+
+    ~MockCamera() {
+        running = false;
+        // Closing the acceptor does not wake a blocking accept(), a connection of our own does
+        beast::error_code ec;
+        tcp::socket wake(ioc);
+        wake.connect(acceptor.local_endpoint(), ec);
+        if (server.joinable()) server.join();
+        // Sessions still blocked reading a client's next request
+        lock_guard<mutex> lock(connections_mutex);
+        for (auto& socket : sockets) socket->shutdown(tcp::socket::shutdown_both, ec);
+        for (auto& connection : connections) connection.join();
+    }
+
+    string port() { return to_string(acceptor.local_endpoint().port()); }
+};
+
+static json runReplay(const string& clip, const string& config_path, int cycles) {
+
+    MockCamera camera;
+
+    json config = baseConfig(config_path);
+    config["stream_url"] = {clip};
+    config["ctrl_port"] = camera.port();
+    config["persistent"] = true;
+    config["auto"] = true;
+
+    Stage cycle("replay.cycle");
+
+    ZCAM zcam(config, 0);
+    ZCAMController controller(config, 0, &zcam);
+
+    for (int i = 0; i < cycles; i++) {
+        someTimer timer(cycle.histogram);
+        ZCAMBench::monitorCam(controller);
+    }
+
+    controller.shutdown();
+    zcam.stopStream();
+    someUploader::getInstance()->close();
+
+    json result;
+    result["mode"] = "replay";
+    result["clip"] = clip;
+    result["cycles"] = cycles;
+    result["camera_sets"] = camera.sets.load();
+    result["cycle"] = cycle.summary();
+    result["stages"] = someMetrics::snapshot();
+    return result;
+}
+
+// Two non-persistent cycles, the way the controller captures by default, on top of a cached layout that
+// claims length-prefixed (avcC) NAL units for an Annex B clip: the decoder opens from it but finds no frame
+static json runStaleLayout(const string& clip, const string& config_path, bool& ok) {
+
+    json config = baseConfig(config_path);
+    config["stream_url"] = {clip};
+    config["stream_cache"] = true;
+
+    const string stale_extradata = "01640028ffe000";
+    string layout_path = SCRATCH + "state/stream_bench.json";
+    fs::create_directories(SCRATCH + "state");
+    {
+        json stale;
+        stale["stream_index"] = 0;
+        stale["codec_id"] = static_cast<int>(AV_CODEC_ID_H264);
+        stale["width"] = 1920;
+        stale["height"] = 1080;
+        stale["pix_fmt"] = static_cast<int>(AV_PIX_FMT_YUV420P);
+        stale["extradata"] = stale_extradata;
+        ofstream(layout_path) << stale.dump();
+    }
+
+    ZCAM zcam(config, 0);
+    json jcycles = json::array();
+    bool captured = false;
+
+    for (int i = 0; i < 2; i++) {
+        json jcycle;
+        AVFrame *frame = zcam.initStream() ? zcam.getFrame() : nullptr;
+        captured = frame != nullptr;
+        if (frame) zcam.releaseFrame(frame);
+        zcam.closeStream();
+
+        string cache = "missing";
+        ifstream file(layout_path);
+        if (file.is_open()) {
+            auto state = json::parse(file, nullptr, false);
+            cache = !state.is_discarded() && state.value("extradata", string()) == stale_extradata ? "stale" : "rewritten";
+        }
+        jcycle["frame"] = captured;
+        jcycle["cache"] = cache;
+        jcycles.push_back(jcycle);
+    }
+
+    // The second cycle must decode, and what it decoded with replaces the stale cache
+    ok = captured && jcycles.back()["cache"] == "rewritten";
+
+    json result;
+    result["mode"] = "stale_layout";
+    result["clip"] = clip;
+    result["cycles"] = jcycles;
+    result["ok"] = ok;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+
+    int iterations = 50;
+    int max_frames = 10;
+    int cycles = 20;
+    string output;
+    string replay;
+    string stale_layout;
+    string config_path;
+    vector<string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool value = i + 1 < argc;
+        if (arg == "--iterations" && value) iterations = max(1, stoi(argv[++i]));
+        else if (arg == "--frames" && value) max_frames = max(1, stoi(argv[++i]));
+        else if (arg == "--cycles" && value) cycles = max(1, stoi(argv[++i]));
+        else if (arg == "--json" && value) output = argv[++i];
+        else if (arg == "--replay" && value) replay = argv[++i];
+        else if (arg == "--stale-layout" && value) stale_layout = argv[++i];
+        else if (arg == "--config" && value) config_path = argv[++i];
+        else inputs.push_back(arg);
+    }
+
+    if (inputs.empty() && replay.empty() && stale_layout.empty()) {
+        cout << "usage: bench [--iterations N] [--frames N] [--config config/site.json] [--json out.json] <clip|jpeg>..." << endl;
+        cout << "       bench --replay <clip> [--cycles N] [--config config/site.json] [--json out.json]" << endl;
+        cout << "       bench --stale-layout <clip> [--config config/site.json] [--json out.json]" << endl;
+        return 1;
+    }
+
+    fs::create_directories(SCRATCH);
+    someLogger::getInstance(SCRATCH + "bench.log");
+
+    bool ok = true;
+    json result = !stale_layout.empty() ? runStaleLayout(stale_layout, config_path, ok) :
+                  replay.empty() ? runStages(inputs, config_path, iterations, max_frames) : runReplay(replay, config_path, cycles);
+
+    if (output.empty()) {
+        cout << result.dump(2) << endl;
+    } else {
+        ofstream file(output);
+        file << result.dump(2) << endl;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#include <exposureModel.h>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <someLogger.h>
+
+namespace fs = filesystem;
+
+ExposureModel::ExposureModel(const json& config, int cam_idx) {
+
+    camera_id = config["cameras"][cam_idx].get<string>();
+    path = config["files"].get<string>() + "state/exposure_" + camera_id + ".json";
+
+    if (config.count("exposure_control") > 0) {
+        auto jcontrol = config["exposure_control"];
+        if (jcontrol.is_object()) {
+            steps = max(1, jcontrol.value("steps", 4));
+            settle_ms = max(0, jcontrol.value("settle_ms", 600));
+            slope = jcontrol.value("slope", 0.5);
+            learn_rate = jcontrol.value("learn_rate", 0.3);
+            settle = jcontrol.value("settle", 0.5);
+            iso_min = jcontrol.value("iso_min", 400);
+            iso_max = jcontrol.value("iso_max", 51200);
+        }
+    }
+
+    load();
+}
+
+void ExposureModel::setOptions(const vector<int>& isos, const vector<string>& irises, const string& min_iris, const string& max_iris) {
+
+    iso_values.clear();
+    for (int iso : isos)
+        if (iso >= iso_min && iso <= iso_max) iso_values.push_back(iso);
+
+    iris_values.clear();
+    double low = stod(min_iris), high = stod(max_iris);
+    for (auto& iris : irises)
+        if (stod(iris) >= low && stod(iris) <= high) iris_values.push_back(iris);
+}
+
+double ExposureModel::ev(int iso, double iris) {
+    return log2(static_cast<double>(iso)) - 2 * log2(iris);
+}
+
+bool ExposureModel::needsCorrection(double brightness, double target, double tolerance) {
+    double error = abs(brightness - target);
+    correcting = error > (correcting ? tolerance * settle : tolerance);
+    return correcting;
+}
+
+bool ExposureModel::predict(double brightness, double target, int& iso, string& iris) const {
+
+    if (iso_values.empty()) return false;
+
+    double aperture = stod(iris);
+    double b = min(255.0, max(1.0, brightness));
+    double target_ev = ev(iso, aperture) + (log2(target) - log2(b)) / slope;
+
+    // ISO first at the current iris, like the ladder - iris only moves once ISO runs out of range
+    double want_iso = pow(2.0, target_ev) * aperture * aperture;
+    int new_iso = *min_element(iso_values.begin(), iso_values.end(), [&](int a, int c) {
+        return abs(log2(a / want_iso)) < abs(log2(c / want_iso));
+    });
+
+    string new_iris = iris;
+    bool saturated = (want_iso > iso_values.back() && new_iso == iso_values.back()) ||
+                     (want_iso < iso_values.front() && new_iso == iso_values.front());
+    if (saturated && !iris_values.empty()) {
+        double want_aperture = sqrt(new_iso / pow(2.0, target_ev));
+        new_iris = *min_element(iris_values.begin(), iris_values.end(), [&](const string& a, const string& c) {
+            return abs(log2(stod(a) / want_aperture)) < abs(log2(stod(c) / want_aperture));
+        });
+        if (abs(stod(new_iris) - aperture) < 1e-6) new_iris = iris;
+    }
+
+    if (new_iso == iso && new_iris == iris) return false;
+
+    iso = new_iso;
+    iris = new_iris;
+    return true;
+}
+
+// Pairs measured a moment apart share the scene light, so the brightness ratio is the camera's response alone
+void ExposureModel::observe(int iso_before, const string& iris_before, double before,
+                            int iso_after, const string& iris_after, double after) {
+
+    double delta_ev = ev(iso_after, stod(iris_after)) - ev(iso_before, stod(iris_before));
+
+    // Clipped frames flatten the response, small steps drown in noise
+    if (abs(delta_ev) < 0.25 || before < 12 || before > 240 || after < 12 || after > 240) return;
+
+    double measured = (log2(after) - log2(before)) / delta_ev;
+    measured = min(max_slope, max(min_slope, measured));
+    slope += learn_rate * (measured - slope);
+    observations++;
+
+    save();
+}
+
+json ExposureModel::status() {
+    json result;
+    result["exposure_slope"] = round(slope * 1000) / 1000;
+    result["exposure_observations"] = observations;
+    return result;
+}
+
+void ExposureModel::load() {
+    ifstream file(path);
+    if (!file.is_open()) return;
+    try {
+        json state = json::parse(file);
+        slope = min(max_slope, max(min_slope, state.value("slope", slope)));
+        observations = state.value("observations", 0);
+    } catch (const exception& e) {
+        someLogger::getInstance()->log(camera_id + " ignoring unreadable exposure model " + path);
+    }
+}
+
+void ExposureModel::save() {
+    error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    ofstream file(path);
+    if (!file.is_open()) return;
+    json state;
+    state["slope"] = slope;
+    state["observations"] = observations;
+    file << state.dump();
+}
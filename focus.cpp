@@ -7,6 +7,7 @@
     Focus::~Focus() {
         cout << "DELETE FOCUS" << endl;
         if (swsContext != nullptr) sws_freeContext(swsContext);
+        if (frameGray != nullptr) av_frame_free(&frameGray);
     }
 
     bool Focus::isSupportedYUVFormat(int format) {
@@ -22,12 +23,123 @@
             case AV_PIX_FMT_YUV410P:    // 6 - YUV 4:1:0
             case AV_PIX_FMT_YUV411P:    // 7 - YUV 4:1:1
             case AV_PIX_FMT_GRAY8:      // 8 - Grayscale
+            case AV_PIX_FMT_NV12:       // 23 - hardware decode output
                 return true;
             default:
                 return false;
         }
     }
     
+namespace {
+
+    // Running sums for one region; which fields are filled depends on the metric
+    struct FocusAccum {
+        int64_t sum = 0;
+        int64_t sum_squared = 0;
+        double magnitude = 0;
+        int64_t count = 0;
+    };
+
+    // Row kernels - plain int32 loops over contiguous bytes that the compiler can vectorize,
+    // widened to int64/double once per row. Every row segment fits int32 up to 4K+ widths.
+
+    // 4-neighbour Laplacian (cv::Laplacian ksize 1), |lap| <= 1020
+    inline void laplacianRow(const uint8_t* up, const uint8_t* row, const uint8_t* down,
+                             int x0, int x1, FocusAccum& acc) {
+        int32_t s = 0;
+        int64_t sq = 0;
+        for (int x = x0; x < x1; x++) {
+            int32_t lap = up[x] + down[x] + row[x - 1] + row[x + 1] - 4 * row[x];
+            s += lap;
+            sq += lap * lap;
+        }
+        acc.sum += s;
+        acc.sum_squared += sq;
+    }
+
+    // Squared horizontal first difference, at most 255^2 per pixel
+    inline void brennanRow(const uint8_t* row, int x0, int x1, FocusAccum& acc) {
+        int32_t sq = 0;
+        for (int x = x0; x < x1; x++) {
+            int32_t d = row[x] - row[x - 1];
+            sq += d * d;
+        }
+        acc.sum_squared += sq;
+    }
+
+    // 3x3 Sobel gradient magnitude, summed where gx^2 + gy^2 > min_squared (-1 keeps every pixel)
+    inline void sobelRow(const uint8_t* up, const uint8_t* row, const uint8_t* down,
+                         int x0, int x1, int32_t min_squared, FocusAccum& acc) {
+        float m = 0;
+        for (int x = x0; x < x1; x++) {
+            int32_t gx = (up[x + 1] + 2 * row[x + 1] + down[x + 1]) - (up[x - 1] + 2 * row[x - 1] + down[x - 1]);
+            int32_t gy = (down[x - 1] + 2 * down[x] + down[x + 1]) - (up[x - 1] + 2 * up[x] + up[x + 1]);
+            int32_t m2 = gx * gx + gy * gy;
+            m += (m2 > min_squared) ? sqrtf(static_cast<float>(m2)) : 0.0f;
+        }
+        acc.magnitude += m;
+    }
+
+    // Tenengrad keeps edges stronger than this gradient magnitude
+    const int32_t TENENGRAD_THRESHOLD = 10;
+
+    inline void accumulateRow(Focus::Method method, const uint8_t* up, const uint8_t* row, const uint8_t* down,
+                              int x0, int x1, FocusAccum& acc) {
+        switch (method) {
+            case Focus::BRENNAN:
+                brennanRow(row, x0, x1, acc);
+                break;
+            case Focus::SOBEL:
+                sobelRow(up, row, down, x0, x1, -1, acc);
+                break;
+            case Focus::TENENGRAD:
+                sobelRow(up, row, down, x0, x1, TENENGRAD_THRESHOLD * TENENGRAD_THRESHOLD, acc);
+                break;
+            default:
+                laplacianRow(up, row, down, x0, x1, acc);
+                break;
+        }
+        acc.count += x1 - x0;
+    }
+
+    // Brennan only looks left; the 3x3 kernels skip the frame border instead of reflecting it
+    inline void clampRegion(Focus::Method method, int width, int height, int& x0, int& y0, int& x1, int& y1) {
+        bool vertical = method != Focus::BRENNAN;
+        x0 = max(1, x0);
+        x1 = min(vertical ? width - 1 : width, x1);
+        y0 = max(vertical ? 1 : 0, y0);
+        y1 = min(vertical ? height - 1 : height, y1);
+    }
+
+    double finish(Focus::Method method, const FocusAccum& acc) {
+        if (acc.count == 0) return 0.0;
+        switch (method) {
+            case Focus::BRENNAN:
+                return static_cast<double>(acc.sum_squared);
+            case Focus::SOBEL:
+                return acc.magnitude / acc.count;
+            case Focus::TENENGRAD:
+                return acc.magnitude;
+            default: {
+                double mean = static_cast<double>(acc.sum) / acc.count;
+                return static_cast<double>(acc.sum_squared) / acc.count - mean * mean;
+            }
+        }
+    }
+
+    double measurePlane(const uint8_t* plane, int linesize, int width, int height,
+                        int x0, int y0, int x1, int y1, Focus::Method method) {
+        FocusAccum acc;
+        clampRegion(method, width, height, x0, y0, x1, y1);
+        for (int y = y0; y < y1 && x0 < x1; y++) {
+            const uint8_t* row = plane + static_cast<ptrdiff_t>(y) * linesize;
+            accumulateRow(method, row - linesize, row, row + linesize, x0, x1, acc);
+        }
+        return finish(method, acc);
+    }
+
+}
+
     // Work directly with decoded frame - no conversion needed
     double Focus::fastROI(AVFrame* frame, int x0, int y0, int x1, int y1) {
     
@@ -37,25 +149,49 @@
             return -1.0;
         }
 
-        x0 = max(0, x0);
-        y0 = max(0, y0);
-        x1 = min(frame->width, x1);
-        y1 = min(frame->height, y1);
-
-        // cout << "fastROI: width: " << frame->width << " height: " << frame->height << " x0: " << x0 << " y0: " << y0 << " x1: " << x1 << " y1: " << y1 << endl;
-        
         // Use Y channel directly (luminance)
-        cv::Mat yMat(frame->height, frame->width, CV_8UC1, 
-                    frame->data[0], frame->linesize[0]);
-
-        // Extract ROI (Region of Interest)
-        int width = x1 - x0;
-        int height = y1 - y0;
-        cv::Rect roi(x0, y0, width, height);
-        cv::Mat roiMat = yMat(roi);  // This creates a view, no copying!
-        
-        // Measure focus using your existing function
-        return laplacianVariance(roiMat);
+        return measurePlane(frame->data[0], frame->linesize[0], frame->width, frame->height, x0, y0, x1, y1, LAPLACIAN);
+    }
+
+    vector<double> Focus::grid(const AVFrame* frame, const FocusGrid& spec, Method method) {
+
+        int rows = max(1, spec.rows);
+        int cols = max(1, spec.cols);
+        vector<double> cells(rows * cols, -1.0);
+
+        if (!isSupportedYUVFormat(frame->format)) {
+            std::cerr << "Unsupported pixel format: " << frame->format << std::endl;
+            return cells;
+        }
+
+        int top = max(0, min(spec.top_margin, frame->height));
+        int dw = frame->width / cols;
+        int dh = (frame->height - top) / rows;
+        if (dw <= 0 || dh <= 0) return cells;
+
+        vector<FocusAccum> accums(rows * cols);
+
+        const uint8_t* plane = frame->data[0];
+        int linesize = frame->linesize[0];
+
+        // Row by row across all cells of a band, so the plane streams through the cache once
+        for (int r = 0; r < rows; r++) {
+            int band_x0 = 0, y0 = top + r * dh, band_x1 = frame->width, y1 = top + (r + 1) * dh;
+            clampRegion(method, frame->width, frame->height, band_x0, y0, band_x1, y1);
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = plane + static_cast<ptrdiff_t>(y) * linesize;
+                for (int c = 0; c < cols; c++) {
+                    int x0 = max(band_x0, c * dw);
+                    int x1 = min(band_x1, (c + 1) * dw);
+                    if (x0 < x1) accumulateRow(method, row - linesize, row, row + linesize, x0, x1, accums[r * cols + c]);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < cells.size(); i++)
+            if (accums[i].count > 0) cells[i] = finish(method, accums[i]);
+
+        return cells;
     }
 
     double Focus::fast(AVFrame* frame) {
@@ -63,29 +199,33 @@
     }
 
     double Focus::measure(AVFrame* frame, Method method) {
-        
-        AVFrame* frameRGB = av_frame_alloc();
 
-        if (!swsContext) {
-            // Initialize scaler
-            swsContext = sws_getContext(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),  // Cast here
-                                       frame->width, frame->height, AV_PIX_FMT_RGB24,
-                                       SWS_BILINEAR, nullptr, nullptr, nullptr);
+        // YUV input already carries luma, the metrics run on the Y plane in place
+        if (isSupportedYUVFormat(frame->format))
+            return measurePlane(frame->data[0], frame->linesize[0], frame->width, frame->height,
+                                0, 0, frame->width, frame->height, method);
 
-        }
+        if (!frameGray) frameGray = av_frame_alloc();
+        if (!frameGray) return -1.0;
 
-        // Convert to RGB
-        sws_scale(swsContext, frame->data, frame->linesize, 0, frame->height, frameRGB->data, frameRGB->linesize);
-                
-        // Convert to OpenCV Mat
-        cv::Mat cvFrame(frame->height, frame->width, CV_8UC3, frameRGB->data[0]);
-        cv::cvtColor(cvFrame, cvFrame, cv::COLOR_RGB2BGR);
+        if (frameGray->width != frame->width || frameGray->height != frame->height) {
+            av_frame_unref(frameGray);
+            frameGray->format = AV_PIX_FMT_GRAY8;
+            frameGray->width = frame->width;
+            frameGray->height = frame->height;
+            if (av_frame_get_buffer(frameGray, 32) < 0) return -1.0;
+        }
 
-        double focus = measure(cvFrame, method);
+        // Rebuilt only when the input size or format changes
+        swsContext = sws_getCachedContext(swsContext, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                          frame->width, frame->height, AV_PIX_FMT_GRAY8,
+                                          SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!swsContext) return -1.0;
 
-        av_frame_free(&frameRGB);  
+        sws_scale(swsContext, frame->data, frame->linesize, 0, frame->height, frameGray->data, frameGray->linesize);
 
-        return focus;
+        return measurePlane(frameGray->data[0], frameGray->linesize[0], frame->width, frame->height,
+                            0, 0, frame->width, frame->height, method);
     }
 
     double Focus::measure(const cv::Mat& frame, Method method, const cv::Rect* bbox) {
@@ -119,48 +259,31 @@
                 return laplacianVariance(roi);
         }
     }
+
+    // 8-bit single-channel view for the row kernels
+    static cv::Mat gray8(const cv::Mat& image) {
+        if (image.type() == CV_8UC1) return image;
+        cv::Mat converted;
+        image.convertTo(converted, CV_8U);
+        return converted;
+    }
     
     double Focus::laplacianVariance(const cv::Mat& image) {
-        cv::Mat laplacian;
-        cv::Laplacian(image, laplacian, CV_64F);
-        
-        cv::Scalar mean, stddev;
-        cv::meanStdDev(laplacian, mean, stddev);
-        return stddev[0] * stddev[0];
+        cv::Mat g = gray8(image);
+        return measurePlane(g.data, static_cast<int>(g.step), g.cols, g.rows, 0, 0, g.cols, g.rows, LAPLACIAN);
     }
     
     double Focus::sobelVariance(const cv::Mat& image) {
-        cv::Mat sobelX, sobelY, magnitude;
-        cv::Sobel(image, sobelX, CV_64F, 1, 0, 3);
-        cv::Sobel(image, sobelY, CV_64F, 0, 1, 3);
-        
-        cv::magnitude(sobelX, sobelY, magnitude);
-        return cv::mean(magnitude)[0];
+        cv::Mat g = gray8(image);
+        return measurePlane(g.data, static_cast<int>(g.step), g.cols, g.rows, 0, 0, g.cols, g.rows, SOBEL);
     }
     
     double Focus::brennanGradient(const cv::Mat& image) {
-        cv::Mat diff;
-        image.convertTo(diff, CV_64F);
-        
-        double sum = 0;
-        for (int i = 0; i < diff.rows; i++) {
-            for (int j = 1; j < diff.cols; j++) {
-                double gradient = diff.at<double>(i, j) - diff.at<double>(i, j-1);
-                sum += gradient * gradient;
-            }
-        }
-        return sum;
+        cv::Mat g = gray8(image);
+        return measurePlane(g.data, static_cast<int>(g.step), g.cols, g.rows, 0, 0, g.cols, g.rows, BRENNAN);
     }
     
     double Focus::tenengrad(const cv::Mat& image) {
-        cv::Mat sobelX, sobelY;
-        cv::Sobel(image, sobelX, CV_64F, 1, 0, 3);
-        cv::Sobel(image, sobelY, CV_64F, 0, 1, 3);
-        
-        cv::Mat magnitude;
-        cv::magnitude(sobelX, sobelY, magnitude);
-        
-        // Apply threshold to focus on strong edges
-        cv::Mat mask = magnitude > 10.0;
-        return cv::sum(magnitude.mul(mask / 255.0))[0];
+        cv::Mat g = gray8(image);
+        return measurePlane(g.data, static_cast<int>(g.step), g.cols, g.rows, 0, 0, g.cols, g.rows, TENENGRAD);
     }
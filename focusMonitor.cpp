@@ -0,0 +1,93 @@
+#include <focusMonitor.h>
+#include <algorithm>
+#include <someLogger.h>
+
+FocusMonitor::FocusMonitor(const json& config, int cam_idx) {
+
+    size_t size = 360;
+
+    camera_id = config["cameras"][cam_idx].get<string>();
+
+    if (config.count("top_margin") > 0)
+        grid.top_margin = config["top_margin"][cam_idx].get<int>();
+
+    if (config.count("focus_monitor") > 0) {
+        auto jmonitor = config["focus_monitor"];
+        if (jmonitor.is_object()) {
+            every = max(1, jmonitor.value("every", 1));
+            recent = max(1, jmonitor.value("recent", 6));
+            size = static_cast<size_t>(max(recent * 2, jmonitor.value("history", 360)));
+            drift_threshold = jmonitor.value("drift", 0.4);
+            grid.rows = max(1, jmonitor.value("rows", 4));
+            grid.cols = max(1, jmonitor.value("cols", 4));
+            string name = jmonitor.value("method", "laplacian");
+            if (name == "sobel") method = Focus::SOBEL;
+            else if (name == "brennan") method = Focus::BRENNAN;
+            else if (name == "tenengrad") method = Focus::TENENGRAD;
+        }
+    }
+
+    history.resize(size);
+}
+
+bool FocusMonitor::sample(const AVFrame* frame) {
+
+    if (!frame || calls++ % every != 0) return false;
+
+    auto cells = Focus::grid(frame, grid, method);
+
+    // Median cell, so one cell with a passing boat or a wet spot does not move the score
+    vector<double> valid;
+    for (double cell : cells)
+        if (cell >= 0) valid.push_back(cell);
+    if (valid.empty()) return false;
+    nth_element(valid.begin(), valid.begin() + valid.size() / 2, valid.end());
+
+    history[head] = {time(nullptr), static_cast<float>(valid[valid.size() / 2])};
+    head = (head + 1) % history.size();
+    count = min(count + 1, history.size());
+
+    update();
+    return true;
+}
+
+void FocusMonitor::update() {
+
+    // Current level: mean of the newest samples
+    size_t n = min(count, static_cast<size_t>(recent));
+    double sum = 0;
+    for (size_t i = 1; i <= n; i++)
+        sum += history[(head + history.size() - i) % history.size()].score;
+    current = sum / n;
+
+    // Baseline: 90th percentile of the whole window, i.e. how sharp this camera gets on a clear lens
+    vector<float> scores;
+    scores.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        scores.push_back(history[(head + history.size() - 1 - i) % history.size()].score);
+    size_t k = scores.size() * 9 / 10;
+    nth_element(scores.begin(), scores.begin() + k, scores.end());
+    baseline = scores[k];
+
+    // Needs a full recent window beyond it before judging, and clears with some hysteresis
+    bool enough = count >= static_cast<size_t>(recent) * 2;
+    double drift = baseline > 0 ? 1.0 - current / baseline : 0.0;
+    bool was = alert;
+    if (!enough) alert = false;
+    else if (drift > drift_threshold) alert = true;
+    else if (drift < drift_threshold / 2) alert = false;
+
+    if (alert != was)
+        someLogger::getInstance()->log(alert ? camera_id + " focus drift " + to_string(static_cast<int>(drift * 100)) + "% below baseline"
+                                             : camera_id + " focus recovered");
+}
+
+json FocusMonitor::status() {
+    json result;
+    if (count == 0) return result;
+    result["focus"] = current;
+    result["focus_baseline"] = baseline;
+    result["focus_drift"] = baseline > 0 ? 1.0 - current / baseline : 0.0;
+    result["focus_alert"] = alert;
+    return result;
+}
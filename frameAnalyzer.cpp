@@ -0,0 +1,243 @@
+#include <frameAnalyzer.h>
+#include <someThreadPool.h>
+#include <someMetrics.h>
+
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+
+someThreadPool& tiles() {
+    static someThreadPool pool;
+    return pool;
+}
+
+const AVPixFmtDescriptor* planarYUV(const AVFrame *frame) {
+    auto desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    if (!desc || desc->comp[0].depth != 8 || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)))
+        return nullptr;
+    return desc;
+}
+
+}
+
+LumaStats FrameAnalysis::luma() const {
+    LumaStats total;
+    for (auto& zone : zones) total.merge(zone);
+    return total;
+}
+
+void FrameAnalysis::merge(const FrameAnalysis& other) {
+    if (zones.size() < other.zones.size()) zones.resize(other.zones.size());
+    for (size_t i = 0; i < other.zones.size(); i++) zones[i].merge(other.zones[i]);
+    bright += other.bright;
+    bright_y += other.bright_y;
+    bright_u += other.bright_u;
+    bright_v += other.bright_v;
+    edges += other.edges;
+    laplacian_sum += other.laplacian_sum;
+    laplacian_squared += other.laplacian_squared;
+}
+
+json FrameAnalysis::toJson() const {
+    auto round2 = [](double value) { return round(value * 100) / 100; };
+    json result;
+    result["sharpness"] = round2(sharpness);
+    if (red + green + blue > 0) {
+        result["wb_red_gain"] = round2(red_gain);
+        result["wb_blue_gain"] = round2(blue_gain);
+        result["wb_cast"] = round2(cast);
+        result["wb_dominant"] = dominant;
+    }
+    return result;
+}
+
+FrameAnalyzer::FrameAnalyzer(const json& config) {
+
+    if (config.count("analysis") == 0 || !config["analysis"].is_object()) return;
+
+    auto janalysis = config["analysis"];
+    tile_rows = max(8, janalysis.value("tile_rows", tile_rows));
+    step = max(1, janalysis.value("step", step));
+    white_threshold = min(254, max(1, janalysis.value("white_threshold", white_threshold)));
+    white_balance = janalysis.value("white_balance", white_balance);
+    focus = janalysis.value("focus", focus);
+}
+
+bool FrameAnalyzer::fullRange(const AVFrame *frame) {
+    auto format = static_cast<AVPixelFormat>(frame->format);
+    return frame->color_range == AVCOL_RANGE_JPEG || format == AV_PIX_FMT_YUVJ420P ||
+           format == AV_PIX_FMT_YUVJ422P || format == AV_PIX_FMT_YUVJ444P || format == AV_PIX_FMT_GRAY8;
+}
+
+FrameAnalysis FrameAnalyzer::analyze(const AVFrame *frame, int x0, int y0, int x1, int y1, int rows, int cols) const {
+
+    FrameAnalysis result;
+    if (!frame || !frame->data[0] || !planarYUV(frame)) return result;
+
+    SOME_TIMED_SCOPE(timer, "analyzeFrame");
+
+    x0 = max(0, x0);
+    y0 = max(0, y0);
+    x1 = min(x1, frame->width);
+    y1 = min(y1, frame->height);
+    rows = max(1, rows);
+    cols = max(1, cols);
+
+    Window window{x0, y0, (x1 - x0) / cols, (y1 - y0) / rows, rows, cols};
+    result.zones.resize(rows * cols);
+    if (window.zone_w <= 0 || window.zone_h <= 0) return result;
+
+    // Band starts stay on the sampling grid so every band sees the same rows a single pass would
+    int band = (tile_rows + step - 1) / step * step;
+    int y_end = y0 + rows * window.zone_h;
+    int bands = (y_end - y0 + band - 1) / band;
+
+    vector<FrameAnalysis> partial(bands);
+    vector<future<void>> done;
+    done.reserve(bands);
+    for (int i = 0; i < bands; i++) {
+        int begin = y0 + i * band;
+        int end = min(y_end, begin + band);
+        done.push_back(tiles().submit([this, frame, &window, begin, end, &partial, i]() {
+            partial[i].zones.resize(window.rows * window.cols);
+            analyzeRows(frame, window, begin, end, partial[i]);
+        }));
+    }
+    for (auto& band_done : done) band_done.get();
+
+    for (auto& band_result : partial) result.merge(band_result);
+    derive(frame, result);
+    return result;
+}
+
+// The hot loop: histogram, moments, Laplacian and bright-pixel chroma for each sampled pixel of rows
+// y_begin..y_end, reading the luma rows once while they are in cache
+void FrameAnalyzer::analyzeRows(const AVFrame *frame, const Window& window, int y_begin, int y_end, FrameAnalysis& result) const {
+
+    auto desc = planarYUV(frame);
+    bool chroma = white_balance && desc->nb_components >= 3;
+    const auto& cb = desc->comp[1];
+    const auto& cr = desc->comp[2];
+
+    // Threshold in the frame's own code values, limited range luma spans 16-235
+    int threshold = fullRange(frame) ? white_threshold : 16 + white_threshold * 219 / 255;
+
+    const uint8_t *plane = frame->data[0];
+    int linesize = frame->linesize[0];
+
+    for (int y = y_begin; y < y_end; y += step) {
+
+        const uint8_t *row = plane + static_cast<size_t>(y) * linesize;
+        const uint8_t *up = row - linesize;
+        const uint8_t *down = row + linesize;
+        bool edge_row = focus && y > 0 && y < frame->height - 1;
+
+        const uint8_t *cb_row = chroma ? frame->data[cb.plane] + static_cast<size_t>(y >> desc->log2_chroma_h) * frame->linesize[cb.plane] + cb.offset : nullptr;
+        const uint8_t *cr_row = chroma ? frame->data[cr.plane] + static_cast<size_t>(y >> desc->log2_chroma_h) * frame->linesize[cr.plane] + cr.offset : nullptr;
+
+        LumaStats *zone_row = &result.zones[((y - window.y0) / window.zone_h) * window.cols];
+
+        for (int c = 0; c < window.cols; c++) {
+
+            LumaStats& zone = zone_row[c];
+            int x_begin = window.x0 + c * window.zone_w;
+            int x_end = x_begin + window.zone_w;
+
+            uint64_t sum = 0, sum_squared = 0, count = 0;
+            uint64_t bright = 0, bright_y = 0, bright_u = 0, bright_v = 0;
+            uint64_t edges = 0, laplacian_squared = 0;
+            int64_t laplacian_sum = 0;
+
+            for (int x = x_begin; x < x_end; x += step) {
+                uint32_t v = row[x];
+                zone.histogram[v]++;
+                sum += v;
+                sum_squared += v * v;
+                count++;
+
+                if (edge_row && x > 0 && x < frame->width - 1) {
+                    int laplacian = 4 * static_cast<int>(v) - up[x] - down[x] - row[x - 1] - row[x + 1];
+                    laplacian_sum += laplacian;
+                    laplacian_squared += static_cast<uint64_t>(laplacian * laplacian);
+                    edges++;
+                }
+
+                if (chroma && static_cast<int>(v) >= threshold) {
+                    int cx = x >> desc->log2_chroma_w;
+                    bright++;
+                    bright_y += v;
+                    bright_u += cb_row[cx * cb.step];
+                    bright_v += cr_row[cx * cr.step];
+                }
+            }
+
+            zone.sum += sum;
+            zone.sum_squared += sum_squared;
+            zone.count += count;
+            result.bright += bright;
+            result.bright_y += bright_y;
+            result.bright_u += bright_u;
+            result.bright_v += bright_v;
+            result.edges += edges;
+            result.laplacian_sum += laplacian_sum;
+            result.laplacian_squared += laplacian_squared;
+        }
+    }
+}
+
+void FrameAnalyzer::derive(const AVFrame *frame, FrameAnalysis& result) const {
+
+    bool full_range = fullRange(frame);
+
+    // Limited range luma (16-235) is stretched to full range so thresholds match the controller's
+    if (!full_range)
+        for (auto& zone : result.zones) zone.expandLimitedRange();
+
+    double luma_scale = full_range ? 1.0 : 255.0 / 219.0;
+    double chroma_scale = full_range ? 1.0 : 255.0 / 224.0;
+
+    if (result.edges > 0) {
+        double mean = static_cast<double>(result.laplacian_sum) / result.edges;
+        double variance = static_cast<double>(result.laplacian_squared) / result.edges - mean * mean;
+        result.sharpness = max(0.0, variance) * luma_scale * luma_scale;
+    }
+
+    // A handful of bright pixels is noise, not a white reference
+    if (result.bright <= 10) return;
+
+    double y = static_cast<double>(result.bright_y) / result.bright;
+    double u = static_cast<double>(result.bright_u) / result.bright - 128.0;
+    double v = static_cast<double>(result.bright_v) / result.bright - 128.0;
+    if (!full_range) y -= 16.0;
+    y *= luma_scale;
+    u *= chroma_scale;
+    v *= chroma_scale;
+
+    // Mean YCbCr to RGB is exact for the mean since the transform is linear (ignoring per-pixel clipping)
+    bool bt709 = frame->colorspace == AVCOL_SPC_BT709;
+    auto clamp255 = [](double value) { return min(255.0, max(0.0, value)); };
+    result.red = clamp255(y + (bt709 ? 1.5748 : 1.402) * v);
+    result.green = clamp255(y - (bt709 ? 0.1873 : 0.3441) * u - (bt709 ? 0.4681 : 0.7141) * v);
+    result.blue = clamp255(y + (bt709 ? 1.8556 : 1.772) * u);
+
+    if (result.red > 0) result.red_gain = result.green / result.red;
+    if (result.blue > 0) result.blue_gain = result.green / result.blue;
+
+    double total = result.red + result.green + result.blue;
+    if (total <= 0) return;
+
+    double r = result.red / total;
+    double g = result.green / total;
+    double b = result.blue / total;
+    result.cast = (abs(r - 1.0 / 3) + abs(g - 1.0 / 3) + abs(b - 1.0 / 3)) * 100.0;
+
+    if (r > 0.36) result.dominant = "warm";
+    else if (b > 0.36) result.dominant = "cool";
+    else if (g > 0.36) result.dominant = "green";
+    else if (g < 0.30) result.dominant = "magenta";
+}
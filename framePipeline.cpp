@@ -0,0 +1,183 @@
+#include <framePipeline.h>
+#include <focusMonitor.h>
+#include <someThreadPool.h>
+#include <someLogger.h>
+#include <someMetrics.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Separate from the camera pool: a cycle running there blocks until its stages finish
+someThreadPool& workers() {
+    static someThreadPool pool;
+    return pool;
+}
+
+double round2(double value) {
+    return round(value * 100) / 100;
+}
+
+}
+
+map<string, FrameStageFactory>& FramePipeline::registry() {
+    static map<string, FrameStageFactory> factories = {
+        {"focus", [](const json& config, int cam_idx) { return new FocusMonitor(config, cam_idx); }},
+        {"white_balance", [](const json& config, int cam_idx) { return new WhiteBalanceStage(config, cam_idx); }},
+        {"scene", [](const json& config, int cam_idx) { return new SceneStage(config, cam_idx); }},
+    };
+    return factories;
+}
+
+void FramePipeline::add(const string& name, FrameStageFactory factory) {
+    registry()[name] = factory;
+}
+
+FramePipeline::FramePipeline(const json& config, int cam_idx) {
+
+    camera_id = config["cameras"][cam_idx].get<string>();
+
+    vector<string> names;
+    if (config.count("pipeline") > 0) names = config["pipeline"].get<vector<string>>();
+    else if (config.count("focus_monitor") > 0) names.push_back("focus");
+
+    for (auto& name : names) {
+        auto it = registry().find(name);
+        if (it == registry().end()) {
+            someLogger::getInstance()->log(camera_id + " unknown pipeline stage " + name);
+            continue;
+        }
+        stages.push_back(it->second(config, cam_idx));
+    }
+}
+
+FramePipeline::~FramePipeline() {
+    for (auto stage : stages) delete stage;
+}
+
+bool FramePipeline::needsAnalysis() const {
+    for (auto stage : stages)
+        if (stage->needsAnalysis()) return true;
+    return false;
+}
+
+FrameStage* FramePipeline::find(const string& name) {
+    for (auto stage : stages)
+        if (stage->name() == name) return stage;
+    return nullptr;
+}
+
+void FramePipeline::run(const AVFrame *frame, const FrameAnalysis& analysis) {
+
+    if (stages.empty() || !frame) return;
+
+    SOME_TIMED_SCOPE(timer, "pipeline");
+
+    // The last stage runs on the calling thread, which would only be waiting otherwise
+    vector<future<void>> done;
+    for (size_t i = 0; i + 1 < stages.size(); i++) {
+        FrameStage *stage = stages[i];
+        done.push_back(workers().submit([stage, frame, &analysis]() { stage->process(frame, analysis); }));
+    }
+    stages.back()->process(frame, analysis);
+    for (auto& stage_done : done) stage_done.get();
+}
+
+json FramePipeline::status() {
+    json result;
+    for (auto stage : stages) {
+        json jstage = stage->status();
+        if (jstage.is_object()) result.update(jstage);
+    }
+    return result;
+}
+
+WhiteBalanceStage::WhiteBalanceStage(const json& config, int cam_idx) {
+
+    camera_id = config["cameras"][cam_idx].get<string>();
+
+    if (config.count("white_balance") > 0 && config["white_balance"].is_object()) {
+        auto jwb = config["white_balance"];
+        smoothing = min(1.0, max(0.01, jwb.value("smoothing", smoothing)));
+        cast_alert = jwb.value("cast_alert", cast_alert);
+        hold = max(1, jwb.value("hold", hold));
+    }
+}
+
+void WhiteBalanceStage::process(const AVFrame *frame, const FrameAnalysis& analysis) {
+
+    // Frames without enough bright pixels (night, fog) say nothing about the white point
+    if (analysis.red + analysis.green + analysis.blue <= 0) return;
+
+    double weight = samples++ == 0 ? 1.0 : smoothing;
+    red_gain += weight * (analysis.red_gain - red_gain);
+    blue_gain += weight * (analysis.blue_gain - blue_gain);
+    cast += weight * (analysis.cast - cast);
+    dominant = analysis.dominant;
+
+    bool was = alert;
+    if (cast > cast_alert) over = max(1, over + 1);
+    else if (cast < cast_alert / 2) over = min(-1, over - 1);
+    else over = 0;
+    if (over >= hold) alert = true;
+    else if (over <= -hold) alert = false;
+
+    if (alert != was)
+        someLogger::getInstance()->log(alert ? camera_id + " white balance cast " + dominant + " " + to_string(static_cast<int>(cast)) + "%"
+                                             : camera_id + " white balance neutral again");
+}
+
+json WhiteBalanceStage::status() {
+    json result;
+    if (samples == 0) return result;
+    result["wb_avg_red_gain"] = round2(red_gain);
+    result["wb_avg_blue_gain"] = round2(blue_gain);
+    result["wb_avg_cast"] = round2(cast);
+    result["wb_alert"] = alert;
+    // Warmer light raises red against blue; 6500K is where the gains meet
+    if (red_gain > 0) result["wb_kelvin"] = static_cast<int>(min(12000.0, max(2000.0, 6500.0 * red_gain / blue_gain)));
+    return result;
+}
+
+void SceneStage::process(const AVFrame *frame, const FrameAnalysis& analysis) {
+
+    LumaStats luma = analysis.luma();
+    if (luma.count == 0) return;
+
+    uint64_t low = 0, mid = 0, high = 0;
+    for (int v = 0; v < 85; v++) low += luma.histogram[v];
+    for (int v = 85; v < 170; v++) mid += luma.histogram[v];
+    for (int v = 170; v < 256; v++) high += luma.histogram[v];
+
+    measured = true;
+    shadows = low * 100.0 / luma.count;
+    midtones = mid * 100.0 / luma.count;
+    highlights = high * 100.0 / luma.count;
+
+    // Darkest level above black and brightest level, each ignoring the outermost 0.1% of pixels
+    uint64_t tail = luma.count / 1000;
+    int darkest = 6, brightest = 255;
+    for (uint64_t seen = 0; darkest < 255 && (seen += luma.histogram[darkest]) <= tail; darkest++) {}
+    for (uint64_t seen = 0; brightest > darkest && (seen += luma.histogram[brightest]) <= tail; brightest--) {}
+    dynamic_range = brightest - darkest;
+
+    double mean = static_cast<double>(luma.sum) / luma.count;
+    double contrast = sqrt(max(0.0, static_cast<double>(luma.sum_squared) / luma.count - mean * mean));
+
+    if (mean < 50) scene = shadows > 70 ? "night" : "underexposed";
+    else if (mean > 200) scene = highlights > 50 ? "bright daylight" : "overexposed";
+    else if (contrast < 20) scene = "flat";
+    else if (contrast > 60) scene = "high contrast";
+    else if (midtones > 70) scene = "balanced";
+    else scene = "mixed";
+}
+
+json SceneStage::status() {
+    json result;
+    if (!measured) return result;
+    result["scene"] = scene;
+    result["tones"] = {round2(shadows), round2(midtones), round2(highlights)};
+    result["dynamic_range"] = dynamic_range;
+    return result;
+}
@@ -0,0 +1,103 @@
+#include <frameRing.h>
+#include <chrono>
+
+FrameRing::FrameRing(int size) {
+    slots.resize(size > 0 ? size : 1, nullptr);
+    for (auto& slot : slots) slot = av_frame_alloc();
+}
+
+// Enough shells for every consumer of a camera to hold a frame at once
+const size_t MAX_SPARE = 8;
+
+FrameRing::~FrameRing() {
+    for (auto& slot : slots) av_frame_free(&slot);
+    for (auto& frame : spare) av_frame_free(&frame);
+}
+
+AVFrame* FrameRing::acquireLocked() {
+    if (spare.empty()) return av_frame_alloc();
+    AVFrame* frame = spare.back();
+    spare.pop_back();
+    return frame;
+}
+
+AVFrame* FrameRing::acquire() {
+    lock_guard<mutex> lock(ring_mutex);
+    return acquireLocked();
+}
+
+void FrameRing::release(AVFrame* frame) {
+    if (!frame) return;
+    av_frame_unref(frame);
+    lock_guard<mutex> lock(ring_mutex);
+    if (spare.size() < MAX_SPARE) spare.push_back(frame);
+    else av_frame_free(&frame);
+}
+
+AVFrame* FrameRing::refAt(uint64_t s) {
+    if (s == 0 || s > seq || seq - s >= slots.size()) return nullptr;
+    AVFrame* slot = slots[s % slots.size()];
+    if (!slot || !slot->buf[0]) return nullptr;
+    AVFrame* frame = acquireLocked();
+    if (frame && av_frame_ref(frame, slot) < 0) {
+        spare.push_back(frame);
+        frame = nullptr;
+    }
+    return frame;
+}
+
+void FrameRing::push(AVFrame* frame) {
+    {
+        lock_guard<mutex> lock(ring_mutex);
+        if (closed) {
+            av_frame_unref(frame);
+            return;
+        }
+        AVFrame* slot = slots[(seq + 1) % slots.size()];
+        av_frame_unref(slot);
+        av_frame_move_ref(slot, frame);
+        seq++;
+    }
+    ring_cv.notify_all();
+}
+
+AVFrame* FrameRing::latest(uint64_t* s) {
+    lock_guard<mutex> lock(ring_mutex);
+    if (s) *s = seq;
+    return refAt(seq);
+}
+
+AVFrame* FrameRing::get(uint64_t s) {
+    lock_guard<mutex> lock(ring_mutex);
+    return refAt(s);
+}
+
+// Blocks until a frame newer than `s` arrives, then returns the newest one and updates `s`
+AVFrame* FrameRing::wait(uint64_t& s, int timeout_ms) {
+    unique_lock<mutex> lock(ring_mutex);
+    auto last = s;
+    bool ready = ring_cv.wait_for(lock, chrono::milliseconds(timeout_ms),
+        [this, last] { return closed || seq > last; });
+    if (!ready || closed) return nullptr;
+    s = seq;
+    return refAt(seq);
+}
+
+uint64_t FrameRing::sequence() {
+    lock_guard<mutex> lock(ring_mutex);
+    return seq;
+}
+
+void FrameRing::open() {
+    lock_guard<mutex> lock(ring_mutex);
+    closed = false;
+}
+
+void FrameRing::close() {
+    {
+        lock_guard<mutex> lock(ring_mutex);
+        closed = true;
+        for (auto& slot : slots) av_frame_unref(slot);
+    }
+    ring_cv.notify_all();
+}
@@ -0,0 +1,52 @@
+#ifndef EXPOSURE_MODEL_H
+#define EXPOSURE_MODEL_H
+
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+// Per-camera ISO/iris -> brightness response, learned from the frames measured right after each change.
+// Exposure value here is log2(ISO / N^2); mean brightness is modelled as log2(B) = offset + slope * EV,
+// where the offset follows the scene light and the slope (the camera's tone curve) is learned.
+class ExposureModel {
+
+    string camera_id;
+    string path;                // learned slope survives restarts
+    double slope = 0.5;         // stops of brightness per stop of exposure, ~gamma of the tone curve
+    double min_slope = 0.2;
+    double max_slope = 1.2;
+    double learn_rate = 0.3;
+    int observations = 0;
+
+    // Hysteresis: start correcting outside tolerance, keep going until inside tolerance * settle
+    double settle = 0.5;
+    bool correcting = false;
+
+    int iso_min = 400;
+    int iso_max = 51200;
+    vector<int> iso_values;
+    vector<string> iris_values;     // only those between the controller's min/max iris
+
+    void load();
+    void save();
+
+public:
+    int steps = 4;              // closed-loop corrections per cycle on the persistent stream
+    int settle_ms = 600;        // camera needs a few frames before a new setting shows
+
+    ExposureModel(const json& config, int cam_idx);
+    void setOptions(const vector<int>& isos, const vector<string>& irises, const string& min_iris, const string& max_iris);
+
+    static double ev(int iso, double iris);
+    bool needsCorrection(double brightness, double target, double tolerance);
+    // Nearest available setting to the predicted one, false when that is the current setting
+    bool predict(double brightness, double target, int& iso, string& iris) const;
+    void observe(int iso_before, const string& iris_before, double before,
+                 int iso_after, const string& iris_after, double after);
+    json status();
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 
 // FFmpeg headers for direct API usage
 extern "C" {
@@ -17,10 +18,20 @@ extern "C" {
 
 using namespace std;
 
+// Equal cells below the top_margin rows; the remainder of an uneven split is left out like the original grid
+struct FocusGrid {
+    int rows = 4;
+    int cols = 4;
+    int top_margin = 0;
+};
+
 class Focus {
 
     SwsContext* swsContext = nullptr;
 
+    // Scratch kept across calls so a steady stream of same-sized frames does not allocate
+    AVFrame* frameGray = nullptr;
+
 public:
     enum Method {
         LAPLACIAN,
@@ -33,6 +44,8 @@ public:
     double measure(AVFrame* frame, Method method = LAPLACIAN);
     static double fast(AVFrame* frame);
 	static double fastROI(AVFrame* frame, int x0, int y0, int x1, int y1);
+    // Sharpness of every cell (row-major) from one integer pass over the Y plane
+    static vector<double> grid(const AVFrame* frame, const FocusGrid& spec, Method method = LAPLACIAN);
     static bool isSupportedYUVFormat(int format);
 
 private:
@@ -0,0 +1,52 @@
+#ifndef FOCUS_MONITOR_H
+#define FOCUS_MONITOR_H
+
+#include <vector>
+#include <ctime>
+#include <nlohmann/json.hpp>
+
+#include <focus.h>
+#include <framePipeline.h>
+
+using namespace std;
+using json = nlohmann::json;
+
+// Tracks grid sharpness of frames the controller already decoded and flags sustained drops
+// (fogging, salt spray) against the camera's own recent clear-lens level; the pipeline's "focus" stage
+class FocusMonitor : public FrameStage {
+
+    struct Sample {
+        time_t time;
+        float score;
+    };
+
+    string camera_id;
+    FocusGrid grid;
+    Focus::Method method = Focus::LAPLACIAN;
+    int every = 1;              // sample one in this many frames handed to sample()
+    int recent = 6;             // samples averaged for the current level
+    double drift_threshold = 0.4;   // alert when the current level is this fraction below the baseline
+    int calls = 0;
+
+    // Fixed-size ring, oldest overwritten
+    vector<Sample> history;
+    size_t head = 0;
+    size_t count = 0;
+
+    double current = 0;
+    double baseline = 0;
+    bool alert = false;
+
+    void update();
+
+public:
+    FocusMonitor(const json& config, int cam_idx);
+    bool sample(const AVFrame* frame);   // true when the frame was measured
+    bool alerting() { return alert; }
+    double level() { return count > 0 ? current : -1; }   // mean of the recent samples, -1 before the first
+    string name() const override { return "focus"; }
+    void process(const AVFrame *frame, const FrameAnalysis& analysis) override { sample(frame); }
+    json status() override;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FRAME_ANALYZER_H
+#define FRAME_ANALYZER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+#include <lumaStats.h>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+using namespace std;
+using json = nlohmann::json;
+
+// Everything one pass over a decoded frame measures. Tiles fill the sums, analyze() merges them
+// and derives the rest.
+struct FrameAnalysis {
+    vector<LumaStats> zones;        // rows x cols over the metered window, row major, full-range luma
+
+    // White balance from bright pixels (foam, clouds), which should be neutral: native Y/Cb/Cr sums
+    uint64_t bright = 0;
+    uint64_t bright_y = 0;
+    uint64_t bright_u = 0;
+    uint64_t bright_v = 0;
+
+    // 4-neighbour Laplacian of the luma plane at every metered pixel off the frame border
+    uint64_t edges = 0;
+    int64_t laplacian_sum = 0;
+    uint64_t laplacian_squared = 0;
+
+    // Derived
+    double red = 0, green = 0, blue = 0;    // mean RGB of the bright pixels, 0 when there are too few
+    double red_gain = 1.0;                  // multipliers that would make them grey
+    double blue_gain = 1.0;
+    double cast = 0.0;                      // deviation from grey in %, 0 = neutral
+    string dominant = "neutral";            // warm, cool, green, magenta or neutral
+    double sharpness = 0.0;                 // Laplacian variance on full-range luma
+
+    LumaStats luma() const;                 // zones merged with equal weight
+    void merge(const FrameAnalysis& other);
+    json toJson() const;
+};
+
+// Fused exposure histogram, white-balance and focus pass over a frame's planes. The metered rows are cut
+// into bands of tile_rows that run in parallel on a pool of their own (camera cycles may be running on
+// the shared one), each band reading its rows once and keeping its sums private until the merge.
+class FrameAnalyzer {
+
+    int tile_rows = 64;
+    int step = 1;                   // sample every Nth row/column
+    int white_threshold = 200;      // full-range luma above which a pixel counts for white balance
+    bool white_balance = true;
+    bool focus = true;
+
+    struct Window {
+        int x0, y0;
+        int zone_w, zone_h;
+        int rows, cols;
+    };
+
+    void analyzeRows(const AVFrame *frame, const Window& window, int y_begin, int y_end, FrameAnalysis& result) const;
+    void derive(const AVFrame *frame, FrameAnalysis& result) const;
+
+public:
+    // config["analysis"]: {tile_rows, step, white_threshold, white_balance, focus}
+    explicit FrameAnalyzer(const json& config);
+    // Window x0..x1, y0..y1 split into rows x cols equal zones; pixels past the last whole zone are skipped
+    FrameAnalysis analyze(const AVFrame *frame, int x0, int y0, int x1, int y1, int rows = 1, int cols = 1) const;
+    FrameAnalysis analyze(const AVFrame *frame) const { return analyze(frame, 0, 0, frame->width, frame->height); }
+    static bool fullRange(const AVFrame *frame);
+};
+
+#endif
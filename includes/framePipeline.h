@@ -0,0 +1,92 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <nlohmann/json.hpp>
+
+#include <frameAnalyzer.h>
+
+using namespace std;
+using json = nlohmann::json;
+
+// One per-frame step of a camera's pipeline. It sees every frame the controller decodes for exposure,
+// together with that frame's fused analysis, so no stage needs a decode or a camera connection of its own.
+class FrameStage {
+public:
+    virtual ~FrameStage() {}
+    virtual string name() const = 0;
+    virtual bool needsAnalysis() const { return false; }   // true makes the controller run FrameAnalyzer
+    virtual void process(const AVFrame *frame, const FrameAnalysis& analysis) = 0;
+    virtual json status() = 0;                              // merged into caminfo
+};
+
+typedef function<FrameStage*(const json& config, int cam_idx)> FrameStageFactory;
+
+// The stages config["pipeline"] lists by name, run side by side on each cycle's frame
+class FramePipeline {
+
+    string camera_id;
+    vector<FrameStage*> stages;
+
+    static map<string, FrameStageFactory>& registry();
+
+public:
+    // Built in: "focus" (FocusMonitor), "white_balance", "scene"
+    static void add(const string& name, FrameStageFactory factory);
+
+    // "focus_monitor" without a "pipeline" still means ["focus"]
+    FramePipeline(const json& config, int cam_idx);
+    ~FramePipeline();
+    bool empty() { return stages.empty(); }
+    bool needsAnalysis() const;
+    FrameStage* find(const string& name);
+    void run(const AVFrame *frame, const FrameAnalysis& analysis);   // returns when every stage is done
+    json status();
+};
+
+// Colour cast of the bright pixels, smoothed across cycles, alerting when it holds above a threshold
+class WhiteBalanceStage : public FrameStage {
+
+    string camera_id;
+    double smoothing = 0.3;         // weight of the newest frame
+    double cast_alert = 6.0;        // % deviation from grey
+    int hold = 3;                   // frames over (or under half) the threshold before the alert changes
+
+    int samples = 0;
+    int over = 0;
+    double red_gain = 1.0;
+    double blue_gain = 1.0;
+    double cast = 0.0;
+    string dominant = "neutral";
+    bool alert = false;
+
+public:
+    WhiteBalanceStage(const json& config, int cam_idx);
+    string name() const override { return "white_balance"; }
+    bool needsAnalysis() const override { return true; }
+    void process(const AVFrame *frame, const FrameAnalysis& analysis) override;
+    json status() override;
+};
+
+// Tonal distribution and a lighting label from the metered luma histogram
+class SceneStage : public FrameStage {
+
+    bool measured = false;
+    double shadows = 0;             // % below 85
+    double midtones = 0;
+    double highlights = 0;          // % from 170
+    int dynamic_range = 0;          // brightest minus darkest non-black level, 0.1% tails ignored
+    string scene = "unknown";
+
+public:
+    SceneStage(const json& config, int cam_idx) {}
+    string name() const override { return "scene"; }
+    bool needsAnalysis() const override { return true; }
+    void process(const AVFrame *frame, const FrameAnalysis& analysis) override;
+    json status() override;
+};
+
+#endif
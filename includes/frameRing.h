@@ -0,0 +1,44 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+using namespace std;
+
+// Small ring of ref-counted decoded frames shared by all consumers of one camera.
+// Every getter returns a new reference (av_frame_ref) that the caller must av_frame_free(),
+// or hand back through release() so the frame shell is reused.
+class FrameRing {
+
+    vector<AVFrame*> slots;
+    vector<AVFrame*> spare;      // released frame shells, no buffers attached
+    uint64_t seq = 0;            // sequence number of the newest frame, 0 = empty
+    bool closed = false;
+    mutex ring_mutex;
+    condition_variable ring_cv;
+
+    AVFrame* refAt(uint64_t s);
+    AVFrame* acquireLocked();
+
+public:
+    explicit FrameRing(int size = 3);
+    ~FrameRing();
+    void push(AVFrame* frame);   // moves the frame's references into the ring
+    AVFrame* latest(uint64_t* s = nullptr);
+    AVFrame* get(uint64_t s);    // nullptr when already overwritten
+    AVFrame* wait(uint64_t& s, int timeout_ms);
+    AVFrame* acquire();          // empty frame, recycled when possible
+    void release(AVFrame* frame);
+    uint64_t sequence();
+    void open();
+    void close();                // drops all frames and wakes waiters
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LUMA_STATS_H
+#define LUMA_STATS_H
+
+#include <cstdint>
+
+// 256-bin luma histogram plus first and second moments, filled in one pass over a Y plane
+struct LumaStats {
+    uint64_t histogram[256] = {0};
+    uint64_t sum = 0;
+    uint64_t sum_squared = 0;
+    uint64_t count = 0;
+
+    void clear();
+    void add(uint8_t value);
+    void remap(const uint8_t lut[256]);   // rebuilds histogram and moments through a value lookup table
+    void expandLimitedRange();            // limited range luma (16-235) stretched to full range
+    void merge(const LumaStats& other, uint64_t weight = 1);
+};
+
+// Runtime-dispatched kernel: AVX2 when the CPU has it, SSE2 on other x86-64, NEON on ARM, scalar otherwise
+class LumaKernel {
+public:
+    // step > 1 samples every step-th row and column
+    static void accumulate(const uint8_t *plane, int linesize, int width, int height, LumaStats& stats, int step = 1);
+    static const char* isa();
+};
+
+#endif
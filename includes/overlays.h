@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <map>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -17,10 +18,20 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
+#include <yuvCompositor.h>
+
 using namespace std;
 
-// #define DEBUG_PRINT(msg) ((void)0) // cout << "[DEBUG] " << msg << std::endl
+// Compile-time log level: 0 errors, 1 info, 2 debug (make debug sets -DLOG_LEVEL=2)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 1
+#endif
+
+#if LOG_LEVEL >= 2
 #define DEBUG_PRINT(msg) cout << "[DEBUG] " << msg << std::endl
+#else
+#define DEBUG_PRINT(msg) ((void)0)
+#endif
 #define ERROR_PRINT(msg) cerr << "[ERROR] " << msg << std::endl
 
 struct GridText {
@@ -69,7 +80,22 @@ private:
     string cropColor = "blue";
     int cropThickness = 3;
 
+    // Graph cache - rebuilt only when layerKey() changes
+    string graphKey;
+    map<string, string> sentArgs;   // "filter/command" -> last args the running graph holds
+
+    // In-place drawing without libavfilter, see compositeFrame()
+    YUVCompositor compositor;
+
     AVFrame* convertToRGBA(AVFrame* inputFrame);
+    bool buildFilterGraph();
+    bool updateFilterGraph();
+    bool sendCommand(const string& target, const string& command, const string& args);
+    string layerKey();
+    string boxArgs(int x, int y, int width, int height, const string& color, int thickness);
+    string captionArgs();
+    string gridArgs(size_t i, double maxValue);
+    double gridMax();
     
 public:
     FrameOverlayProcessor(int width, int height, AVPixelFormat format);
@@ -77,6 +103,8 @@ public:
     bool initializeFilterGraph();
     bool isInitialized() { return initialized; }
     AVFrame* processFrame(AVFrame* inputFrame);
+    // Draws box, crop, grid text, caption and logo directly into the frame's planes (copy-on-write)
+    bool compositeFrame(AVFrame* frame);
     void setBox(int x, int y, int width, int height, const string& color = "red", int thickness = 3);
     void hideBox();
     void setCrop(int x, int y, int width, int height, const string& color = "blue", int thickness = 3);
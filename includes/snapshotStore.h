@@ -0,0 +1,91 @@
+#ifndef SNAPSHOT_STORE_H
+#define SNAPSHOT_STORE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+// Per-camera JPEG store: one append-only segment per local day (<day>.seg) plus a fixed-size record
+// index (<day>.idx). The index is kept in memory sorted by time, so range queries are a binary search
+// and writes stay sequential. Whole days are evicted, oldest first, to hold the size/age budget.
+class SnapshotStore {
+
+public:
+    struct Entry {
+        int64_t time = 0;           // ms since epoch
+        uint64_t offset = 0;        // into the day's segment
+        uint32_t size = 0;
+        uint32_t iso = 0;
+        float iris = 0;
+        float brightness = 0;
+        float contrast = 0;
+        float exposure = 0;
+        float focus = -1;           // -1 when not measured
+        uint32_t day = 0;           // YYYYMMDD, implied by the file the record lives in
+    };
+
+private:
+    // On-disk index record, little-endian as written by this host
+    struct Record {
+        int64_t time;
+        uint64_t offset;
+        uint32_t size;
+        uint32_t iso;
+        float iris;
+        float brightness;
+        float contrast;
+        float exposure;
+        float focus;
+        uint32_t reserved;
+    };
+
+    struct Day {
+        vector<Entry> entries;
+        uint64_t bytes = 0;         // segment plus index on disk
+    };
+
+    string camera;
+    string dir;
+    uint64_t max_bytes = 1024ull << 20;
+    int max_days = 14;
+
+    mutex store_mutex;
+    map<uint32_t, Day> days;
+    uint64_t total_bytes = 0;
+
+    // Open files of the day being written
+    uint32_t open_day = 0;
+    FILE *segment = nullptr;
+    FILE *index = nullptr;
+
+    static map<string, SnapshotStore*> stores;
+    static mutex stores_mutex;
+
+    SnapshotStore(const json& config, const string& camera);
+    static uint32_t dayOf(int64_t time);
+    string path(uint32_t day, const char *extension);
+    void load(uint32_t day);
+    bool openDay(uint32_t day);
+    void closeDay();
+    void enforceBudget(uint32_t today);
+
+public:
+    // One store per camera, shared by the exposure loop (writer) and the service (reader); nullptr unless config["store"]
+    static SnapshotStore* forCamera(const json& config, const string& camera);
+    ~SnapshotStore();
+
+    bool append(const Entry& metadata, const vector<uint8_t>& jpeg);    // offset/size/day are filled in
+    vector<Entry> query(int64_t from, int64_t to, size_t limit = 1000);
+    bool read(const Entry& entry, vector<uint8_t>& jpeg);
+    static json toJson(const Entry& entry);
+    json status();
+};
+
+#endif
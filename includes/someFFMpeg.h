@@ -3,6 +3,10 @@
 #define SOME_FFMPEG_H
 
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <nlohmann/json.hpp>
 
 // FFmpeg C API headers
 extern "C" {
@@ -16,9 +20,45 @@ extern "C" {
 
 using namespace std;
 
+// One output size of a snapshot; width 0 keeps the decoded size
+struct someRendition {
+	string name = "full";
+	int width = 0;
+	int quality = 100;
+};
+
+// Decoder threading and latency, config["decoder"] (an object, or a list with one per camera)
+struct someDecoderOptions {
+	int threads = 0;                // 0 lets FFmpeg pick one per core
+	int thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+	bool low_delay = false;         // AV_CODEC_FLAG_LOW_DELAY, which also rules out frame threading
+	int max_delay_ms = 3000;        // demuxer reorder window
+};
+
+// Receives each encoded rendition, e.g. to write it to a file or a snapshot store
+typedef function<void(const someRendition& rendition, const vector<uint8_t>& jpeg)> someRenditionSink;
+
 class someFFMpeg {
 public:
-	static void saveAVFrameAsJPEG(AVFrame *frame, const string& path, int quality);
+	static someDecoderOptions decoderOptions(const nlohmann::json& config, int cam_idx = 0);
+	// Decoder for a demuxed stream: codec, extradata (SPS/PPS), size and format come from codecpar, threading
+	// from options; configure() runs just before avcodec_open2 (hwaccel, skip flags) and may veto with false
+	static AVCodecContext* openDecoder(const AVCodecParameters *codecpar, const someDecoderOptions& options,
+	                                   const function<bool(AVCodecContext *ctx)>& configure = nullptr);
+	// config["renditions"]: [{name, width, quality}], a single full-size quality 100 JPEG when absent
+	static vector<someRendition> renditions(const nlohmann::json& config);
+	// base + ".JPG" for full size, base + "_" + name + ".JPG" otherwise
+	static string renditionPath(const string& base, const someRendition& rendition);
+	// Scaled YUVJ420P copy from a per-thread SwsContext/frame cache keyed by size; owned by the cache
+	static const AVFrame* scaleFrame(const AVFrame *frame, int width);
+	static void encodeRenditions(const AVFrame *frame, const vector<someRendition>& renditions, const someRenditionSink& sink);
+	static void encodeRenditionsAsync(const AVFrame *frame, const vector<someRendition>& renditions, someRenditionSink sink);
+	static void saveRenditions(const AVFrame *frame, const string& base, const vector<someRendition>& renditions);
+	static void saveRenditionsAsync(const AVFrame *frame, const string& base, const vector<someRendition>& renditions);
+	// MJPEG encoders are opened once per (width, height, pix_fmt, quality) and reused
+	static bool encodeJPEG(const AVFrame *frame, int quality, vector<uint8_t>& jpeg);
+	static bool saveAVFrameAsJPEG(AVFrame *frame, const string& path, int quality);
+	static bool writeJPEG(const string& path, const vector<uint8_t>& jpeg);
 };
 
 #endif 
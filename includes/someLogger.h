@@ -7,6 +7,11 @@
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <nlohmann/json.hpp>
 
 using namespace std;
@@ -16,13 +21,56 @@ namespace fs = filesystem;
 enum class someLogLevel { ERROR, INFO, DEBUG, DEFAULT };
 enum class Colors { BLACK=30, RED=31, GREEN=32, YELLOW=33, BLUE=34, MAGENTA=35};
 
+// log() only queues the message; a writer thread formats, writes and rotates the file.
+// Producers never block - when the ring is full or the rate limit is hit the message is counted and dropped.
 class someLogger {
 private:
+    struct Entry {
+        atomic<uint64_t> seq;
+        uint64_t ts;
+        bool echo;
+        string message;
+    };
+
+    static const size_t RING_SIZE = 4096;   // power of two
+
     FILE *fp;
+    string path;
     someLogLevel defaultLogLevel;
     uint64_t last = 0;
     static someLogger *_instance;
+
+    // Bounded MPSC ring (per-slot sequence numbers), the writer thread is the only consumer
+    unique_ptr<Entry[]> ring;
+    atomic<uint64_t> enqueue_pos{0};
+    uint64_t dequeue_pos = 0;
+    atomic<uint64_t> dropped{0};
+    uint64_t dropped_reported = 0;
+
+    atomic<bool> running{true};
+    mutex wake_mutex;
+    condition_variable wake_cv;
+    thread writer;
+
+    // Size-based rotation: path -> path.1 -> ... -> path.<keep>
+    size_t max_bytes = 16 << 20;
+    int keep = 3;
+    size_t written = 0;
+
+    // Messages per second, 0 = unlimited
+    atomic<int> max_rate{0};
+    atomic<int64_t> rate_second{0};
+    atomic<int> rate_count{0};
+
+    // Writer-side timestamp cache, reformatted once per second
+    time_t cached_second = 0;
+    char cached_stamp[32] = {0};
+
     someLogger(string filename, someLogLevel level);
+    bool enqueue(string&& message, bool echo);
+    void drain();
+    void write(const Entry& entry);
+    void rotate();
 public:
     static someLogger *getInstance(string filename, someLogLevel = someLogLevel::INFO);
     static someLogger *getInstance();
@@ -39,6 +87,9 @@ public:
     void log(string message, Colors = Colors::BLACK, someLogLevel = someLogLevel::DEFAULT);
     void error(string message);
     void close();
+    void setRotation(size_t bytes, int files);
+    void setRateLimit(int per_second) { max_rate = per_second; }
+    uint64_t droppedCount() { return dropped; }
 };
 
 #endif //LOGGER_H
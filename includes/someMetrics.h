@@ -0,0 +1,70 @@
+#ifndef SOME_METRICS_H
+#define SOME_METRICS_H
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+// Log-linear latency histogram in microseconds: exact below 8us, 8 sub-buckets per power of two above
+// (under 7% error). record() is a few relaxed atomic adds, safe from any thread without locking.
+class someHistogram {
+
+    static const int BUCKETS = 8 + 61 * 8;
+
+    atomic<uint64_t> counts[BUCKETS];
+    atomic<uint64_t> total{0};
+    atomic<uint64_t> sum{0};
+    atomic<uint64_t> peak{0};
+
+    static int bucket(uint64_t us);
+    static double midpoint(int index);
+
+public:
+    const string name;
+
+    explicit someHistogram(const string& name);
+    void record(uint64_t us);
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t sumMicros() const { return sum.load(std::memory_order_relaxed); }
+    double percentile(double p) const;      // microseconds, p in 0..1
+    json summary() const;                   // count, mean/p50/p90/p99/max in ms
+};
+
+// Records the lifetime of the scope into a histogram
+class someTimer {
+    someHistogram& histogram;
+    chrono::steady_clock::time_point start;
+    bool running = true;
+public:
+    explicit someTimer(someHistogram& histogram) : histogram(histogram), start(chrono::steady_clock::now()) {}
+    ~someTimer() { stop(); }
+    uint64_t elapsed() const {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    }
+    void stop() {
+        if (!running) return;
+        running = false;
+        histogram.record(elapsed());
+    }
+};
+
+// Process-wide registry of stage histograms. Lookups take a lock, so call sites keep the reference
+// in a function-local static (SOME_TIMED_SCOPE) and the hot path stays lock-free.
+class someMetrics {
+public:
+    static someHistogram& histogram(const string& name);
+    static json snapshot();                  // { stage: summary } for every stage that has samples
+    static string prometheus();              // text exposition format
+    static void serve(int port, const string& address = "127.0.0.1");   // background HTTP listener answering with prometheus()
+};
+
+#define SOME_TIMED_SCOPE(var, name) \
+    static someHistogram& var##_histogram = someMetrics::histogram(name); \
+    someTimer var(var##_histogram)
+
+#endif
@@ -10,6 +10,7 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <future>
+#include <functional>
 
 namespace beast = boost::beast;     // from <boost/beast.hpp>
 namespace http = beast::http;       // from <boost/beast/http.hpp>
@@ -20,6 +21,8 @@ class someNetwork {
 
     bool log = false;
     uint parse_response(http::response<http::dynamic_body> res, bool verbose = false);
+    http::response<http::dynamic_body> https_exchange(const string& host, const string& port,
+                                                      http::request<http::string_body>& req, int timeout = 60);
 
 public:
 
@@ -38,6 +41,13 @@ public:
     Response https_get(string host, string url, string authorization = "", string port = "443");
     Response https_request(string host, string url, http::verb method, nlohmann::json params = nlohmann::json(), string authorization = "", string port = "443");
     bool https_download(string host, string url, string path, string authorization = "", string port = "443");
+    // Server-sent events: on_event gets each "data:" payload until the stream ends or it returns false.
+    // false means the server never answered with text/event-stream, so the caller should poll instead.
+    bool https_events(string host, string url, function<bool(const string&)> on_event, string authorization = "",
+                      string port = "443", int idle_timeout = 90);
+    // Chunked request body pulled from next() until it returns false, for bodies produced while they upload
+    Response https_stream(string host, string url, http::verb method, const string& content_type,
+                          function<bool(string& chunk)> next, string authorization = "", string port = "443");
 };
 
 
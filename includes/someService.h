@@ -7,24 +7,47 @@
 #include <algorithm>    // std::sort
 #include <vector>       // std::vector
 #include <functional>
+#include <map>
+#include <atomic>
+#include <chrono>
 #include <nlohmann/json.hpp>
 
 #include <zcamSnapshot.h>
+#include <someThreadPool.h>
 
 using namespace std;
 using namespace nlohmann;
 
 class someService {
+public:
+    typedef function<json(const json& params)> Handler;
+private:
     json config;
     string server;
     string host;
     string serviceName;
     ZCAMSnapshot* snapshotService;
+    map<string, ZCAMSnapshot*> cameraSnapshots;   // multi-camera mode, by camera name
     void post_status(string status);
     void post_response(json, string status, json response = json());
+    json snapshot(const json& params);
+    string cameraName(const json& params);
+    json eachCamera(const json& params, function<json(ZCAMSnapshot*)> action);
+
+    // api name -> handler, run on the worker pool; the handler's result is posted back as the response
+    map<string, Handler> handlers;
+    someThreadPool *workers = nullptr;
+    atomic<bool> stopping{false};
+    bool push = false;
+    string push_url = "/apis/requests/stream";
+    chrono::milliseconds min_poll{1000};
+    void configure();
+    void dispatch(const json& request);
 public:
-    explicit someService(json config, string serviceName);
+    explicit someService(json config, string serviceName, ZCAM *zcam = nullptr);
+    someService(json config, string serviceName, const vector<ZCAM*>& sources);
     function<void(json)> onMessage;
+    void handle(const string& api, Handler handler);   // register before run()
     void run();
 };
 
@@ -0,0 +1,41 @@
+#ifndef SOME_THREAD_POOL_H
+#define SOME_THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+using namespace std;
+
+// Fixed-size worker pool shared by all cameras of one process
+class someThreadPool {
+
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queue_mutex;
+    condition_variable queue_cv;
+    bool stopping = false;
+
+    void work();
+
+public:
+    explicit someThreadPool(int threads = 0);   // 0 = one per hardware thread
+    ~someThreadPool();
+    void post(function<void()> task);
+    int size() { return static_cast<int>(workers.size()); }
+
+    template <class F>
+    auto submit(F&& f) -> future<decltype(f())> {
+        auto task = make_shared<packaged_task<decltype(f())()>>(std::forward<F>(f));
+        auto result = task->get_future();
+        post([task]() { (*task)(); });
+        return result;
+    }
+};
+
+#endif
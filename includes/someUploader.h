@@ -0,0 +1,57 @@
+#ifndef SOME_UPLOADER_H
+#define SOME_UPLOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using namespace nlohmann;
+
+// Background poster for telemetry records - callers enqueue and return, a worker thread batches,
+// retries with backoff and spills to disk while the server is unreachable
+class someUploader {
+
+    struct Item {
+        string url;
+        json record;
+        string mirror;   // local file the record is also written to, empty for none
+    };
+
+    string server;
+    string spool_dir;
+    size_t capacity = 64;     // records held in memory, the oldest spill to disk beyond that
+    size_t batch_size = 1;    // 1 keeps the one-object-per-POST wire format, more posts a JSON array
+    int max_backoff = 300;    // seconds between retries (upper bound)
+    uintmax_t max_spool = 16 << 20;
+
+    deque<Item> queue;
+    mutex queue_mutex;
+    condition_variable queue_cv;
+    bool closed = false;
+    mutex spool_mutex;        // post() spills overflow while the worker replays
+    thread worker;
+
+    static someUploader *_instance;
+    someUploader(const json& config);
+
+    void drain();
+    bool send(const string& url, const vector<json>& records);
+    string spoolPath(const string& url);
+    void spill(const string& url, const vector<json>& records);
+    static vector<json> readSpool(const string& path);
+    bool replay(const string& url);
+    static void writeMirror(const Item& item);
+
+public:
+    static someUploader *getInstance(const json& config);
+    static someUploader *getInstance();
+    void post(const string& url, const json& record, const string& mirror = "");
+    void close();   // spills whatever is still queued and stops the worker
+};
+
+#endif
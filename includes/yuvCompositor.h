@@ -0,0 +1,57 @@
+#ifndef YUV_COMPOSITOR_H
+#define YUV_COMPOSITOR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+using namespace std;
+
+struct YUVColor {
+    uint8_t y, u, v;
+};
+
+// Draws boxes, text and a logo straight into planar YUV / NV12 frames, touching only the
+// pixels under the overlay. Glyphs are rasterized once per size, the logo is converted once.
+class YUVCompositor {
+
+    struct Font {
+        cv::Mat atlas;           // CV_8UC1 coverage, printable ASCII side by side
+        int x[95];               // glyph column in the atlas
+        int width[95];
+        int height = 0;
+    };
+
+    map<int, Font> fonts;
+
+    // Logo converted to the target layout, premultiplied by its alpha
+    const AVFrame* logoSource = nullptr;
+    int logoFormat = -1;
+    bool logoFullRange = false;
+    int logoWidth = 0, logoHeight = 0;
+    vector<uint8_t> logoY, logoA;              // luma resolution
+    vector<uint8_t> logoU, logoV, logoCA;      // chroma resolution
+
+    Font& font(int size);
+    bool convertLogo(const AVFrame* rgba, int format, bool full_range);
+    void fill(AVFrame* frame, int x, int y, int w, int h, const YUVColor& color);
+    void blend(AVFrame* frame, int x, int y, const uint8_t* mask, int stride, int w, int h, const YUVColor& color);
+
+public:
+    static bool isSupported(int format);
+    static bool isFullRange(const AVFrame* frame);
+    static YUVColor color(const string& name, bool full_range);   // names or 0xRRGGBB
+    int textWidth(const string& text, int size);
+    int textHeight(int size);
+    bool drawRect(AVFrame* frame, int x, int y, int w, int h, const YUVColor& color, int thickness);
+    bool drawText(AVFrame* frame, int x, int y, const string& text, const YUVColor& color, int size);
+    bool drawLogo(AVFrame* frame, const AVFrame* rgba, int x, int y);
+};
+
+#endif
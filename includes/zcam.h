@@ -3,8 +3,17 @@
 
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <map>
 #include <nlohmann/json.hpp>
 
+#include <frameRing.h>
+#include <someFFMpeg.h>
+
 // FFmpeg C API headers
 extern "C" {
 #include <libavformat/avformat.h>
@@ -12,6 +21,7 @@ extern "C" {
 #include <libavutil/imgutils.h>
 #include <libavutil/frame.h>
 #include <libavutil/error.h>
+#include <libavutil/hwcontext.h>
 #include <libswscale/swscale.h>
 }
 
@@ -20,6 +30,12 @@ using namespace nlohmann;
 
 class ZCAM {
 
+public:
+
+    // Decode sampling - "keyframe" feeds the decoder IDR access units only, "fast" also skips the loop filter
+    enum Sampling { SAMPLE_ALL, SAMPLE_KEYFRAME, SAMPLE_KEYFRAME_FAST };
+
+private:
 
 	string root;
     string camera_ip;
@@ -31,8 +47,74 @@ class ZCAM {
     AVCodecContext *codec_ctx = nullptr;
     const AVCodec *codec = nullptr;  // Use const AVCodec* for newer FFmpeg versions
     int video_stream_index = -1;
+    Sampling sampling = SAMPLE_ALL;
+    someDecoderOptions decoder;
+
+    // Optional hardware decode ("hwaccel": "cuda" or "vaapi"), kept across reconnects
+    AVHWDeviceType hw_type = AV_HWDEVICE_TYPE_NONE;
+    AVPixelFormat hw_pix_fmt = AV_PIX_FMT_NONE;
+    string hw_device;
+    AVBufferRef *hw_device_ctx = nullptr;
+    AVFrame *sw_frame = nullptr;
+    AVBufferPool *download_pool = nullptr;   // host buffers for hw frame downloads
+    int download_size = 0;
+
+    // Reused by getFrame() so one-shot captures do not allocate per call
+    AVPacket *capture_packet = nullptr;
+    int max_packets = 100;       // getFrame() gives up after this many packets without a frame
+
+    // Persistent session - the drainer thread owns format_ctx/codec_ctx while streaming
+    thread drainer;
+    mutex session_mutex;         // serializes startStream()/stopStream() callers
+    atomic<bool> streaming{false};
+    atomic<bool> stopping{false};  // aborts blocking reads in stopStream()
+    mutex backoff_mutex;
+    condition_variable backoff_cv;
+    int max_backoff = 60;        // seconds between reconnect attempts (upper bound)
+
+    // Decoded frames shared by every consumer of this camera
+    FrameRing frames;
+
+    // Last stream layout that decoded, files/state/stream_<camera>.json ("stream_cache": false turns it off).
+    // A reconnect opens the decoder from it instead of sniffing packets; the first decoded frame confirms it.
+    struct StreamLayout {
+        int stream_index = -1;
+        int codec_id = 0;
+        int width = 0;
+        int height = 0;
+        int pix_fmt = -1;
+        vector<uint8_t> extradata;  // Annex B parameter sets (SPS/PPS, plus VPS for HEVC)
+    };
+    bool stream_cache = true;
+    string layout_path;
+    StreamLayout layout;
+    bool layout_confirmed = true;   // false from every decoder open until its first frame
+    bool layout_cached = false;     // the unconfirmed decoder came from the cache
+    int layout_packets = 0;         // packets read since a cached open without a frame
+    map<int, vector<uint8_t>> keyframe_sets;   // NAL type -> newest parameter set seen, the cache's extradata
+
+    mutex hook_mutex;
+    function<void()> connect_hook;
 
 	bool detectVideoStream();
+    bool openCachedLayout();
+    void loadLayout();
+    void confirmLayout(const AVFrame *frame);
+    bool layoutFailed();
+    enum NalKind { NAL_OTHER, NAL_PARAMETER_SET, NAL_KEY_SLICE, NAL_SLICE };
+    static NalKind nalKind(AVCodecID codec_id, uint8_t header, int& type);
+    void collectParameterSets(const AVPacket *pkt);
+    vector<uint8_t> parameterSets() const;
+    bool wantPacket(const AVPacket *pkt);
+    bool openDecoder(const AVCodecParameters *codecpar);
+    bool setupHWDecoder();
+    bool receiveFrame(AVFrame *frame);
+    bool downloadFrame(AVFrame *frame);
+    static AVPixelFormat getHWFormat(AVCodecContext *ctx, const AVPixelFormat *formats);
+    void drainStream();
+    static int interruptCallback(void *opaque);
+    static bool hasStartCode(const uint8_t *data, int size);
+    static bool isKeyPacket(const AVPacket *pkt, AVCodecID codec_id);
 
 public:
 
@@ -41,8 +123,18 @@ public:
     bool initStream();
     void closeStream();
     AVFrame* getFrame();
+    void releaseFrame(AVFrame *frame) { frames.release(frame); }   // recycles frames from getFrame/waitFrame/latestFrame
     bool captureFrame(vector<uint8_t>& rgb_data, int& width, int& height);
     void cleanup();
+    // Runs once the decoder is open on every (re)connect, e.g. to ask the camera for an IDR right away
+    void setConnectHook(function<void()> hook);
+
+    // Long-lived stream mode
+    bool startStream();
+    void stopStream();
+    bool isStreaming() { return streaming; }
+    AVFrame* waitFrame(uint64_t& seq, int timeout_ms = 5000);
+    AVFrame* latestFrame(int timeout_ms = 5000);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,40 @@
+#ifndef ZCAM_CONTROL_H
+#define ZCAM_CONTROL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <someNetwork.h>
+
+using namespace std;
+
+// HTTP client for the camera's /ctrl API, keeping keep-alive connections open between calls
+class ZCAMControl {
+
+    struct Connection;
+
+    string camera_ip;
+    string port;
+    int timeout = 5;    // seconds per request
+
+    boost::asio::io_context ioc;    // resolver only, each connection runs on its own
+    boost::asio::ip::tcp::resolver::results_type endpoints;
+    mutex pool_mutex;
+    vector<unique_ptr<Connection>> idle;
+
+    unique_ptr<Connection> reuse();
+    unique_ptr<Connection> connect();
+    void release(unique_ptr<Connection> conn);
+
+public:
+    explicit ZCAMControl(const string& camera_ip, const string& port = "80");
+    ~ZCAMControl();
+    someNetwork::Response get(const string& endpoint);
+    vector<someNetwork::Response> getAll(const vector<string>& endpoints);   // results in request order
+};
+
+#endif
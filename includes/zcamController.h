@@ -6,6 +6,16 @@
 #include <nlohmann/json.hpp>
 
 #include <someNetwork.h>
+#include <zcam.h>
+#include <zcamControl.h>
+#include <someFFMpeg.h>
+#include <someUploader.h>
+#include <focusMonitor.h>
+#include <exposureModel.h>
+#include <snapshotStore.h>
+#include <lumaStats.h>
+#include <frameAnalyzer.h>
+#include <framePipeline.h>
 
 using namespace std;
 using json = nlohmann::json;
@@ -20,6 +30,18 @@ struct ExposureMetrics {
     int total_pixels = 0;
 };
 
+// Exposure metering, from config["metering"]
+struct MeteringConfig {
+    enum Mode { UNIFORM, ROI, ZONES };
+    Mode mode = UNIFORM;
+    int step = 1;                     // sample every Nth row/column
+    int top_margin = 0;               // sky/horizon rows left out; also the roi's y0 unless "roi" is set
+    int roi[4] = {0, 0, 0, 0};        // x0, y0, x1, y1 - x1/y1 of 0 mean the frame edge
+    int rows = 3;                     // zone grid over the roi
+    int cols = 3;
+    vector<int> weights;              // rows * cols integer zone weights, row major
+};
+
 // Camera state
 struct CameraSettings {
     int iso = 500;
@@ -71,8 +93,37 @@ private:
     string http_base_url;
 
 	string snapshot;
+	vector<someRendition> renditions;
+	someRendition preview;       // rendition caminfo points the dashboard at
+
+	// config["store"]: the store rendition goes to the day segment with this cycle's metrics instead of a flat file
+	SnapshotStore *store = nullptr;
+	string store_rendition = "full";
 	int refresh = 5;
 	bool auto_adjust = false;
+
+	// Long-lived stream: keep the RTSP session open and sample every `interval` seconds
+	bool persistent = false;
+	int interval = 10;
+	uint64_t frame_seq = 0;
+
+	ZCAM *zcam;
+	bool owns_zcam = true;
+
+	// /ctrl API client, connections stay open across cycles
+	ZCAMControl *control;
+	someUploader *uploader;
+
+	// config["pipeline"]: focus, white balance and scene stages on the frames the exposure loop already decodes
+	FramePipeline *pipeline = nullptr;
+	FocusMonitor *focus_monitor = nullptr;     // the pipeline's "focus" stage, owned by it
+
+	// Model-driven exposure instead of the ISO ladder, config["exposure_control"]
+	ExposureModel *exposure_model = nullptr;
+
+	// config["analysis"]: exposure, white balance and sharpness from one tiled parallel pass
+	FrameAnalyzer *analyzer = nullptr;
+	FrameAnalysis analysis;
 	
 	bool stop = false;
 	string server;
@@ -84,6 +135,7 @@ private:
     CameraSettings settings;
     CameraState camera_state;
 	ExposureMetrics metrics;
+	MeteringConfig metering;
 
     int adjustment_count = 0;
 
@@ -93,19 +145,27 @@ private:
     someNetwork::Response httpRequest(const string& endpoint, const string& method = "GET", const string& data = "");
 
     ExposureMetrics analyzeExposure(const vector<uint8_t>& rgb_data, int width, int height);
+    ExposureMetrics analyzeExposure(const AVFrame *frame);
+    ExposureMetrics exposureFromStats(const LumaStats& stats);
     bool adjustExposure(const ExposureMetrics& metrics);
+    bool convergeExposure();
     bool applySetting(const string& param, const string& value);
-	bool initializeStream();
-    bool detectVideoStream();
-	bool captureFrame(vector<uint8_t>& rgb_data, int& width, int& height);
+	AVFrame* captureFrame();
+	void storeSnapshot(const AVFrame *frame);
     bool monitorCam();
     void cleanup();
 
+    // bench.cpp times the private analysis stages directly
+    friend class ZCAMBench;
+
 public:
-    ZCAMController(const json& config, const int cam_idx);
+    ZCAMController(const json& config, const int cam_idx, ZCAM *source = nullptr);
     ~ZCAMController();
     void run();
+    int cycle();
     void shutdown();
+    bool stopped() { return stop; }
+    string cameraId() { return camera_id; }
 
 };
 
@@ -4,10 +4,16 @@
 #include <string>
 #include <iostream>
 #include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
 #include <nlohmann/json.hpp>
 
 #include <zcam.h>
+#include <someFFMpeg.h>
 #include <overlays.h>
+#include <focus.h>
+#include <snapshotStore.h>
 
 using namespace std;
 using json = nlohmann::json;
@@ -19,11 +25,41 @@ class ZCAMSnapshot {
 	int cam_idx;
 	string cam_name;
 	ZCAM * zcam;
+	bool shared = false;   // zcam is the live session owned by main, serve from its frame ring
 	std::unique_ptr<FrameOverlayProcessor> overlayProcessor;
+	int overlay_format = AV_PIX_FMT_NONE;
+	bool focus_grid = false;   // "focus_grid" config - burn per-cell sharpness into every snapshot
+	FocusGrid grid;
+	vector<someRendition> renditions;
+	json last_paths;   // rendition name -> path of the latest take()
+	mutex take_mutex;   // the service runs requests on a pool, one capture per camera at a time
+
+	// Burst and timelapse frames go straight from the decoder to the server, config["burst"]
+	string server;
+	string host;
+	string burst_url = "/apis/snapshots/burst";
+	int burst_max = 100;
+	int burst_quality = 90;
+	mutex timelapse_mutex;   // timelapse and timelapse_stop requests may run side by side on the pool
+	thread timelapse_thread;
+	atomic<bool> timelapse_running{false};
+	SnapshotStore *store = nullptr;
+
+	AVFrame* overlayGrid(AVFrame *frame);
+	json series(int count, int interval_ms, int quality, const string& mode);
+	void timelapseLoop(int count, int interval_s, int quality);
+	void joinTimelapse();    // caller holds timelapse_mutex
 
 public:
-    explicit ZCAMSnapshot(json config);
-	string take();
+    explicit ZCAMSnapshot(json config, ZCAM *source = nullptr);
+    ~ZCAMSnapshot();
+	string take();       // path of the first rendition
+	json lastPaths();
+	json burst(const json& params);       // count frames interval_ms apart, streamed as one multipart upload
+	json timelapse(const json& params);   // one frame every interval seconds in the background until count or stop
+	void stopTimelapse();
+	json history(const json& params);     // stored snapshots between from and to (ms), index only
+	json fetch(const json& params);       // the same range streamed to the server like a burst
 };
 
 #endif
\ No newline at end of file
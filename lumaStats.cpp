@@ -0,0 +1,259 @@
+#include <lumaStats.h>
+#include <cstring>
+#include <array>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LUMA_X86 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define LUMA_NEON 1
+#endif
+
+void LumaStats::clear() {
+    memset(histogram, 0, sizeof(histogram));
+    sum = sum_squared = count = 0;
+}
+
+void LumaStats::add(uint8_t value) {
+    histogram[value]++;
+    sum += value;
+    sum_squared += static_cast<uint64_t>(value) * value;
+    count++;
+}
+
+void LumaStats::remap(const uint8_t lut[256]) {
+    uint64_t mapped[256] = {0};
+    for (int v = 0; v < 256; v++) mapped[lut[v]] += histogram[v];
+    memcpy(histogram, mapped, sizeof(histogram));
+    sum = sum_squared = 0;
+    for (uint64_t v = 0; v < 256; v++) {
+        sum += v * histogram[v];
+        sum_squared += v * v * histogram[v];
+    }
+}
+
+void LumaStats::expandLimitedRange() {
+    static const auto expand = [] {
+        std::array<uint8_t, 256> lut;
+        for (int v = 0; v < 256; v++) lut[v] = (std::max(16, std::min(235, v)) - 16) * 255 / 219;
+        return lut;
+    }();
+    remap(expand.data());
+}
+
+void LumaStats::merge(const LumaStats& other, uint64_t weight) {
+    for (int v = 0; v < 256; v++) histogram[v] += other.histogram[v] * weight;
+    sum += other.sum * weight;
+    sum_squared += other.sum_squared * weight;
+    count += other.count * weight;
+}
+
+namespace {
+
+// Four interleaved histogram banks break the store-to-load dependency on runs of equal pixels
+struct Banks {
+    uint32_t h[4][256];
+    Banks() { memset(h, 0, sizeof(h)); }
+
+    inline void add8(uint64_t v) {
+        h[0][v & 0xFF]++;
+        h[1][(v >> 8) & 0xFF]++;
+        h[2][(v >> 16) & 0xFF]++;
+        h[3][(v >> 24) & 0xFF]++;
+        h[0][(v >> 32) & 0xFF]++;
+        h[1][(v >> 40) & 0xFF]++;
+        h[2][(v >> 48) & 0xFF]++;
+        h[3][v >> 56]++;
+    }
+
+    void mergeInto(LumaStats& stats) {
+        for (int v = 0; v < 256; v++)
+            stats.histogram[v] += static_cast<uint64_t>(h[0][v]) + h[1][v] + h[2][v] + h[3][v];
+    }
+};
+
+// Banks are flushed every this many rows so the 32-bit counters can not overflow on large frames
+const int FLUSH_ROWS = 1024;
+
+void scalarRow(const uint8_t *row, int from, int width, Banks& banks, uint64_t& sum, uint64_t& sum_squared) {
+    for (int x = from; x < width; x++) {
+        uint32_t v = row[x];
+        banks.h[x & 3][v]++;
+        sum += v;
+        sum_squared += v * v;
+    }
+}
+
+void accumulateScalar(const uint8_t *plane, int linesize, int width, int height, LumaStats& stats) {
+    Banks banks;
+    for (int y = 0; y < height; y++) {
+        scalarRow(plane + static_cast<size_t>(y) * linesize, 0, width, banks, stats.sum, stats.sum_squared);
+        if ((y + 1) % FLUSH_ROWS == 0) { banks.mergeInto(stats); banks = Banks(); }
+    }
+    banks.mergeInto(stats);
+}
+
+#ifdef LUMA_X86
+
+void accumulateSSE2(const uint8_t *plane, int linesize, int width, int height, LumaStats& stats) {
+    Banks banks;
+    const __m128i zero = _mm_setzero_si128();
+    alignas(16) uint64_t sums[2];
+    alignas(16) uint32_t squares[4];
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = plane + static_cast<size_t>(y) * linesize;
+        __m128i acc_sum = zero;
+        __m128i acc_sq = zero;   // 32-bit lanes grow by at most 4 * 255^2 per block, per row that can not overflow
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            acc_sum = _mm_add_epi64(acc_sum, _mm_sad_epu8(v, zero));
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            acc_sq = _mm_add_epi32(acc_sq, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+            banks.add8(static_cast<uint64_t>(_mm_cvtsi128_si64(v)));
+            banks.add8(static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v))));
+        }
+        _mm_store_si128(reinterpret_cast<__m128i*>(sums), acc_sum);
+        _mm_store_si128(reinterpret_cast<__m128i*>(squares), acc_sq);
+        stats.sum += sums[0] + sums[1];
+        stats.sum_squared += static_cast<uint64_t>(squares[0]) + squares[1] + squares[2] + squares[3];
+        scalarRow(row, x, width, banks, stats.sum, stats.sum_squared);
+        if ((y + 1) % FLUSH_ROWS == 0) { banks.mergeInto(stats); banks = Banks(); }
+    }
+    banks.mergeInto(stats);
+}
+
+__attribute__((target("avx2")))
+void accumulateAVX2(const uint8_t *plane, int linesize, int width, int height, LumaStats& stats) {
+    Banks banks;
+    const __m256i zero = _mm256_setzero_si256();
+    alignas(32) uint64_t sums[4];
+    alignas(32) uint32_t squares[8];
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = plane + static_cast<size_t>(y) * linesize;
+        __m256i acc_sum = zero;
+        __m256i acc_sq = zero;
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+            acc_sum = _mm256_add_epi64(acc_sum, _mm256_sad_epu8(v, zero));
+            __m256i lo = _mm256_unpacklo_epi8(v, zero);
+            __m256i hi = _mm256_unpackhi_epi8(v, zero);
+            acc_sq = _mm256_add_epi32(acc_sq, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+            __m128i v0 = _mm256_castsi256_si128(v);
+            __m128i v1 = _mm256_extracti128_si256(v, 1);
+            banks.add8(static_cast<uint64_t>(_mm_cvtsi128_si64(v0)));
+            banks.add8(static_cast<uint64_t>(_mm_extract_epi64(v0, 1)));
+            banks.add8(static_cast<uint64_t>(_mm_cvtsi128_si64(v1)));
+            banks.add8(static_cast<uint64_t>(_mm_extract_epi64(v1, 1)));
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sums), acc_sum);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(squares), acc_sq);
+        stats.sum += sums[0] + sums[1] + sums[2] + sums[3];
+        for (int i = 0; i < 8; i++) stats.sum_squared += squares[i];
+        scalarRow(row, x, width, banks, stats.sum, stats.sum_squared);
+        if ((y + 1) % FLUSH_ROWS == 0) { banks.mergeInto(stats); banks = Banks(); }
+    }
+    banks.mergeInto(stats);
+}
+
+#endif
+
+#ifdef LUMA_NEON
+
+void accumulateNEON(const uint8_t *plane, int linesize, int width, int height, LumaStats& stats) {
+    Banks banks;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = plane + static_cast<size_t>(y) * linesize;
+        uint32x4_t acc_sum = vdupq_n_u32(0);
+        uint32x4_t acc_sq = vdupq_n_u32(0);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16_t v = vld1q_u8(row + x);
+            acc_sum = vpadalq_u16(acc_sum, vpaddlq_u8(v));
+            acc_sq = vpadalq_u16(acc_sq, vmull_u8(vget_low_u8(v), vget_low_u8(v)));
+            acc_sq = vpadalq_u16(acc_sq, vmull_u8(vget_high_u8(v), vget_high_u8(v)));
+            uint64x2_t words = vreinterpretq_u64_u8(v);
+            banks.add8(vgetq_lane_u64(words, 0));
+            banks.add8(vgetq_lane_u64(words, 1));
+        }
+        uint32_t sums[4], squares[4];
+        vst1q_u32(sums, acc_sum);
+        vst1q_u32(squares, acc_sq);
+        for (int i = 0; i < 4; i++) {
+            stats.sum += sums[i];
+            stats.sum_squared += squares[i];
+        }
+        scalarRow(row, x, width, banks, stats.sum, stats.sum_squared);
+        if ((y + 1) % FLUSH_ROWS == 0) { banks.mergeInto(stats); banks = Banks(); }
+    }
+    banks.mergeInto(stats);
+}
+
+#endif
+
+void accumulateStrided(const uint8_t *plane, int linesize, int width, int height, int step, LumaStats& stats) {
+    Banks banks;
+    for (int y = 0; y < height; y += step) {
+        const uint8_t *row = plane + static_cast<size_t>(y) * linesize;
+        int i = 0;
+        for (int x = 0; x < width; x += step, i++) {
+            uint32_t v = row[x];
+            banks.h[i & 3][v]++;
+            stats.sum += v;
+            stats.sum_squared += v * v;
+        }
+        if ((y / step + 1) % FLUSH_ROWS == 0) { banks.mergeInto(stats); banks = Banks(); }
+    }
+    banks.mergeInto(stats);
+}
+
+typedef void (*KernelFn)(const uint8_t*, int, int, int, LumaStats&);
+
+struct Dispatch {
+    KernelFn fn = accumulateScalar;
+    const char* name = "scalar";
+    Dispatch() {
+#ifdef LUMA_X86
+        fn = accumulateSSE2;
+        name = "sse2";
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            fn = accumulateAVX2;
+            name = "avx2";
+        }
+#elif defined(LUMA_NEON)
+        fn = accumulateNEON;
+        name = "neon";
+#endif
+    }
+};
+
+const Dispatch& dispatch() {
+    static const Dispatch d;
+    return d;
+}
+
+}
+
+void LumaKernel::accumulate(const uint8_t *plane, int linesize, int width, int height, LumaStats& stats, int step) {
+    if (!plane || width <= 0 || height <= 0) return;
+    if (step > 1) {
+        // Strided samples are not contiguous, and at 1/step^2 of the pixels the scalar loop is cheap
+        accumulateStrided(plane, linesize, width, height, step, stats);
+        stats.count += static_cast<uint64_t>((width + step - 1) / step) * ((height + step - 1) / step);
+        return;
+    }
+    dispatch().fn(plane, linesize, width, height, stats);
+    stats.count += static_cast<uint64_t>(width) * height;
+}
+
+const char* LumaKernel::isa() {
+    return dispatch().name;
+}
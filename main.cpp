@@ -1,13 +1,47 @@
 #include <string>
 #include <iostream>
+#include <atomic>
 
 #include <zcamController.h>
 #include <someService.h>
 #include <someLogger.h>
+#include <someThreadPool.h>
+#include <someMetrics.h>
 
 using namespace std;
 using json = nlohmann::json;
 
+// Runs every controller's monitoring cycle on the shared pool, each camera at its own cadence
+static void scheduleCameras(vector<ZCAMController*>& cameras, someThreadPool& pool, atomic<bool>& running) {
+
+	vector<chrono::steady_clock::time_point> due(cameras.size(), chrono::steady_clock::now());
+	vector<atomic<bool>> busy(cameras.size());
+	mutex due_mutex;
+
+	while (running) {
+		auto now = chrono::steady_clock::now();
+		for (size_t i = 0; i < cameras.size(); i++) {
+			if (busy[i]) continue;
+			{
+				lock_guard<mutex> lock(due_mutex);
+				if (now < due[i]) continue;
+			}
+			busy[i] = true;
+			pool.post([&, i]() {
+				int delay = cameras[i]->cycle();
+				lock_guard<mutex> lock(due_mutex);
+				due[i] = chrono::steady_clock::now() + chrono::seconds(delay);
+				busy[i] = false;
+			});
+		}
+		this_thread::sleep_for(chrono::seconds(1));
+	}
+
+	// Let in-flight cycles finish before the vectors above go out of scope
+	for (size_t i = 0; i < cameras.size(); i++)
+		while (busy[i]) this_thread::sleep_for(chrono::milliseconds(100));
+}
+
 // Simple test of just the frame capture
 int main(int argc, char* argv[]) {
 
@@ -16,7 +50,7 @@ string root;
 ZCAMController *camera;
 
 	if (argc < 3) {
-		cout << "usage: cameraController <host> <cam_id>" << endl;
+		cout << "usage: cameraController <host> <cam_id|all>" << endl;
 		exit(0);
 	}
 
@@ -28,27 +62,78 @@ ZCAMController *camera;
 	
 	config["host"] = site;	
 
-	config["cam_id"] = cam_id;
+	config["cam_id"] = cam_id == "all" ? "0" : cam_id;
 
 	root = config["files"].get<string>();
 
-    someLogger::getInstance(root + "logs/zcam" + cam_id + ".log")->log("start zcam controller");
+    someLogger *logger = someLogger::getInstance(root + "logs/zcam" + cam_id + ".log");
+	if (config.count("log") > 0) {
+		json log_config = config["log"];
+		logger->setRotation(static_cast<size_t>(log_config.value("max_mb", 16)) << 20, log_config.value("keep", 3));
+		logger->setRateLimit(log_config.value("rate", 0));
+	}
+	logger->log("start zcam controller");
+
+	if (config.count("metrics_port") > 0)
+		someMetrics::serve(config["metrics_port"].get<int>(), config.value("metrics_bind", string("127.0.0.1")));
 
     json cameras = config["cameras"];
 
-	camera = new ZCAMController(config, stoi(cam_id));
+	bool persistent = config.count("persistent") > 0 && config["persistent"].get<bool>();
+
+    string serviceName = config["service"].get<string>();
+
+	if (cam_id == "all") {
+
+		// One process for the whole site: shared worker pool, shared service poller
+		vector<ZCAM*> sources;
+		vector<ZCAMController*> controllers;
+
+		for (size_t i = 0; i < cameras.size(); i++) {
+			ZCAM *zcam = persistent ? new ZCAM(config, i) : nullptr;
+			sources.push_back(zcam);
+			controllers.push_back(new ZCAMController(config, i, zcam));
+		}
+
+		int threads = config.count("threads") > 0 ? config["threads"].get<int>() :
+			static_cast<int>(min<size_t>(cameras.size(), max(1u, thread::hardware_concurrency())));
+		someThreadPool pool(threads);
+
+		atomic<bool> running{true};
+		thread scheduler([&]() {
+			scheduleCameras(controllers, pool, running);
+		});
+
+		auto service = new someService(config, serviceName, sources);
+		someLogger::getInstance()->log("start service for " + to_string(cameras.size()) + " cameras");
+		service->run();
+
+		running = false;
+		for (auto controller : controllers) controller->shutdown();
+		if (scheduler.joinable()) scheduler.join();
+		someUploader::getInstance()->close();
+
+		return 0;
+	}
+
+	// In persistent mode one live session per camera feeds both the exposure loop and snapshots
+	ZCAM *zcam = nullptr;
+	if (persistent)
+		zcam = new ZCAM(config, stoi(cam_id));
+
+	camera = new ZCAMController(config, stoi(cam_id), zcam);
 
     thread camThread([camera]() {
         camera->run();
     });
 
-    string serviceName = config["service"].get<string>();
-    auto service = new someService(config, serviceName + cam_id);
+    auto service = new someService(config, serviceName + cam_id, zcam);
     someLogger::getInstance()->log("start service");
     service->run();
-        
+
     if (camThread.joinable()) {
         camThread.join();
     }
+    someUploader::getInstance()->close();
 
 }
@@ -27,8 +27,6 @@
     void FrameOverlayProcessor::setCaptionText(const string& text) {
         cout << "SET CAPTION# " << text << endl;
         captionText = text;
-        initialized = false;
-        initializeFilterGraph();
     }
     
     void FrameOverlayProcessor::setFont(const std::string& path, int size) {
@@ -173,8 +171,6 @@
    
     void FrameOverlayProcessor::hideBox() {
         showBox = false;
-        initialized = false;
-        initializeFilterGraph();
     }
 
     // Add these methods:
@@ -227,8 +223,130 @@
         return rgbaFrame;
     }
     
+    string FrameOverlayProcessor::boxArgs(int x, int y, int width, int height, const string& color, int thickness) {
+        return "x=" + to_string(x) + ":y=" + to_string(y) + ":w=" + to_string(width) + ":h=" + to_string(height) +
+               ":color=" + color + ":t=" + to_string(thickness);
+    }
+
+    string FrameOverlayProcessor::captionArgs() {
+        return "text='" + captionText + "':x=20:y=h-th-20:fontsize=" + to_string(fontSize) + ":fontcolor=" + fontColor;
+    }
+
+    double FrameOverlayProcessor::gridMax() {
+        double maxValue = 0;
+        for (auto& point : grid) maxValue = max(maxValue, point.value);
+        return maxValue;
+    }
+
+    string FrameOverlayProcessor::gridArgs(size_t i, double maxValue) {
+        string color = grid[i].value == maxValue ? "yellow" : "red";
+        return "text='" + to_string(i) + ":" + grid[i].text + "':x=" + to_string(grid[i].x) + ":y=" + to_string(grid[i].y) +
+               ":fontsize=40:fontcolor=" + color;
+    }
+
+    // Everything that changes the shape of the graph; values inside a layer do not
+    string FrameOverlayProcessor::layerKey() {
+        return to_string(frameWidth) + "x" + to_string(frameHeight) + ":" + to_string(pixelFormat) +
+               (showBox ? ":box" : "") + (showCrop ? ":crop" : "") + (captionText.empty() ? "" : ":caption") +
+               ":grid" + to_string(grid.size()) + (logoLoaded && logoFrame ? ":logo" : "") +
+               ":" + fontPath + ":" + fontName;
+    }
+
+    // Pushes one filter's new options into the running graph, skipped when unchanged
+    bool FrameOverlayProcessor::sendCommand(const string& target, const string& command, const string& args) {
+        string key = target + "/" + command;
+        auto it = sentArgs.find(key);
+        if (it != sentArgs.end() && it->second == args) return true;
+
+        char response[256] = {0};
+        int ret = avfilter_graph_send_command(filterGraph, target.c_str(), command.c_str(), args.c_str(),
+                                              response, sizeof(response), 0);
+        if (ret < 0) {
+            char error_buf[256];
+            av_strerror(ret, error_buf, sizeof(error_buf));
+            ERROR_PRINT("Command " << command << " to " << target << " failed: " << error_buf);
+            return false;
+        }
+        sentArgs[key] = args;
+        return true;
+    }
+
+    bool FrameOverlayProcessor::updateFilterGraph() {
+
+        bool ok = true;
+
+        if (showBox) {
+            ok &= sendCommand("box", "x", to_string(boxX));
+            ok &= sendCommand("box", "y", to_string(boxY));
+            ok &= sendCommand("box", "w", to_string(boxWidth));
+            ok &= sendCommand("box", "h", to_string(boxHeight));
+            ok &= sendCommand("box", "color", boxColor);
+            ok &= sendCommand("box", "t", to_string(boxThickness));
+        }
+
+        if (showCrop) {
+            ok &= sendCommand("crop", "x", to_string(cropX));
+            ok &= sendCommand("crop", "y", to_string(cropY));
+            ok &= sendCommand("crop", "w", to_string(cropWidth));
+            ok &= sendCommand("crop", "h", to_string(cropHeight));
+            ok &= sendCommand("crop", "color", cropColor);
+            ok &= sendCommand("crop", "t", to_string(cropThickness));
+        }
+
+        if (!captionText.empty())
+            ok &= sendCommand("caption", "reinit", captionArgs());
+
+        double maxValue = gridMax();
+        for (size_t i = 0; i < grid.size(); i++)
+            ok &= sendCommand("grid_" + to_string(i), "reinit", gridArgs(i, maxValue));
+
+        return ok;
+    }
+
+    // Builds the graph only when the layer set changed; otherwise new values go in as filter commands
     bool FrameOverlayProcessor::initializeFilterGraph() {
 
+        if (initialized && filterGraph && layerKey() == graphKey) {
+            if (updateFilterGraph()) return true;
+            // A filter that refused the command gets a clean rebuild
+            initialized = false;
+        }
+
+        if (!buildFilterGraph()) {
+            graphKey.clear();
+            return false;
+        }
+
+        graphKey = layerKey();
+
+        // The freshly built filters already hold the current values
+        sentArgs.clear();
+        if (showBox) {
+            sentArgs["box/x"] = to_string(boxX);
+            sentArgs["box/y"] = to_string(boxY);
+            sentArgs["box/w"] = to_string(boxWidth);
+            sentArgs["box/h"] = to_string(boxHeight);
+            sentArgs["box/color"] = boxColor;
+            sentArgs["box/t"] = to_string(boxThickness);
+        }
+        if (showCrop) {
+            sentArgs["crop/x"] = to_string(cropX);
+            sentArgs["crop/y"] = to_string(cropY);
+            sentArgs["crop/w"] = to_string(cropWidth);
+            sentArgs["crop/h"] = to_string(cropHeight);
+            sentArgs["crop/color"] = cropColor;
+            sentArgs["crop/t"] = to_string(cropThickness);
+        }
+        if (!captionText.empty()) sentArgs["caption/reinit"] = captionArgs();
+        double maxValue = gridMax();
+        for (size_t i = 0; i < grid.size(); i++)
+            sentArgs["grid_" + to_string(i) + "/reinit"] = gridArgs(i, maxValue);
+
+        return true;
+    }
+
+    bool FrameOverlayProcessor::buildFilterGraph() {
+
         DEBUG_PRINT("reinit filter graph");
 
         // Clean up previous graph if exists
@@ -374,18 +492,12 @@
             } else {
                 DEBUG_PRINT("Creating drawbox filter...");
                 
-                // Use the actual boxX/boxY position (not center calculation)
-                std::string drawBoxArgs = "x=" + std::to_string(boxX);        // NOW using boxX
-                drawBoxArgs += ":y=" + std::to_string(boxY);                  // NOW using boxY
-                drawBoxArgs += ":w=" + std::to_string(boxWidth);
-                drawBoxArgs += ":h=" + std::to_string(boxHeight);
-                drawBoxArgs += ":color=" + boxColor;
-                drawBoxArgs += ":t=" + std::to_string(boxThickness);
+                std::string drawBoxArgs = boxArgs(boxX, boxY, boxWidth, boxHeight, boxColor, boxThickness);
                 
                 DEBUG_PRINT("drawBoxArgs: " << drawBoxArgs);
                 DEBUG_PRINT("Box position: (" << boxX << "," << boxY << "), size: " << boxWidth << "x" << boxHeight);
                 
-                ret = avfilter_graph_create_filter(&drawBoxCtx, drawBox, "drawbox",
+                ret = avfilter_graph_create_filter(&drawBoxCtx, drawBox, "box",
                                                    drawBoxArgs.c_str(), nullptr, filterGraph);
 
                           // CRITICAL: Link the drawbox to the previous filter in the chain
@@ -412,18 +524,12 @@
             } else {
                 DEBUG_PRINT("Creating drawbox filter...");
                 
-                // Use the actual boxX/boxY position (not center calculation)
-                std::string drawCropArgs = "x=" + std::to_string(cropX);        // NOW using boxX
-                drawCropArgs += ":y=" + std::to_string(cropY);                  // NOW using boxY
-                drawCropArgs += ":w=" + std::to_string(cropWidth);
-                drawCropArgs += ":h=" + std::to_string(cropHeight);
-                drawCropArgs += ":color=" + cropColor;
-                drawCropArgs += ":t=" + std::to_string(cropThickness);
+                std::string drawCropArgs = boxArgs(cropX, cropY, cropWidth, cropHeight, cropColor, cropThickness);
                 
                 DEBUG_PRINT("drawBoxArgs: " << drawCropArgs);
                 DEBUG_PRINT("Box position: (" << cropX << "," << cropY << "), size: " << cropWidth << "x" << cropHeight);
                 
-                ret = avfilter_graph_create_filter(&drawCropCtx, drawCrop, "drawbox",
+                ret = avfilter_graph_create_filter(&drawCropCtx, drawCrop, "crop",
                                                    drawCropArgs.c_str(), nullptr, filterGraph);
 
                           // CRITICAL: Link the drawbox to the previous filter in the chain
@@ -451,11 +557,7 @@
                 // Continue without text overlay
             } else {
                 
-                std::string drawTextArgs = "text='" + captionText + "'";
-                drawTextArgs += ":x=20:y=h-th-20";
-                drawTextArgs += ":fontsize=" + to_string(fontSize);
-                drawTextArgs += ":fontcolor=" + fontColor;
-                // drawTextArgs += ":box=1:boxcolor=black@0.3:boxborderw=5";
+                std::string drawTextArgs = captionArgs();
 
                 DEBUG_PRINT("drawTextArgs: " << drawTextArgs);
                 
@@ -476,7 +578,7 @@
 
                 DEBUG_PRINT("drawTextArgs+: " << drawTextArgs);
                 
-                ret = avfilter_graph_create_filter(&drawTextCtx, drawText, "drawtext",
+                ret = avfilter_graph_create_filter(&drawTextCtx, drawText, "caption",
                                                    drawTextArgs.c_str(), nullptr, filterGraph);
                 if (ret < 0) {
                     char error_buf[256];
@@ -498,15 +600,10 @@
             }
         }
 
-        double maxValue = 0;
-
-        for (int i = 0; i < grid.size(); i++)
-            maxValue = max(maxValue, grid[i].value);
-
-        cout << "MAX VALUE: " << to_string(maxValue) << endl;
+        double maxValue = gridMax();
 
         // Create multiple drawtext filters - one for each grid cell
-        for (int i = 0; i < grid.size(); i++) {
+        for (size_t i = 0; i < grid.size(); i++) {
 
                 AVFilterContext* drawTextCtx = nullptr;
                 const AVFilter* drawText = avfilter_get_by_name("drawtext");
@@ -516,28 +613,9 @@
                     continue;
                 }
                 
-                int x = grid[i].x;
-                int y = grid[i].y;
-
-                // Format focus value
-                // double focusValue = focusGrid[row][col];
-                // std::string focusText = std::to_string(static_cast<int>(focusValue));
-                string focusText = grid[i].text;
-
-                string color = "red";
-
-                if (grid[i].value == maxValue) color = "yellow";
-                
-                // Choose color based on focus quality
-                // std::string color = getFocusColor(focusValue);
-                
-                std::string drawTextArgs = "text='" + to_string(i) + ":" + focusText + "'";
-                drawTextArgs += ":x=" + std::to_string(x);
-                drawTextArgs += ":y=" + std::to_string(y);
-                drawTextArgs += ":fontsize=40";
-                drawTextArgs += ":fontcolor=" + color;
+                std::string drawTextArgs = gridArgs(i, maxValue);
 
-                cout << "drawTextArgs: " << drawTextArgs << endl;
+                DEBUG_PRINT("drawTextArgs: " << drawTextArgs);
                 
                 // Add font
                 #ifdef _WIN32
@@ -549,7 +627,7 @@
                 #endif
                                 
                 ret = avfilter_graph_create_filter(&drawTextCtx, drawText, 
-                                                 ("drawtext_" + to_string(x) + "_" + to_string(y)).c_str(),
+                                                 ("grid_" + to_string(i)).c_str(),
                                                  drawTextArgs.c_str(), nullptr, filterGraph);
                 
                 if (ret < 0) {
@@ -646,20 +724,57 @@
         return true;
     }
     
+    // Same layers as the filter graph, drawn natively; cost scales with the overlay area, not the frame.
+    // fontPath/fontName only apply to drawtext, the native glyphs are OpenCV Hershey at fontSize.
+    bool FrameOverlayProcessor::compositeFrame(AVFrame* frame) {
+
+        if (!YUVCompositor::isSupported(frame->format)) {
+            ERROR_PRINT("compositeFrame# unsupported format " << frame->format);
+            return false;
+        }
+
+        // Decoded frames are shared with the ring, only a private copy may be drawn on
+        if (av_frame_make_writable(frame) < 0) return false;
+
+        bool full_range = YUVCompositor::isFullRange(frame);
+
+        if (showBox)
+            compositor.drawRect(frame, boxX, boxY, boxWidth, boxHeight, YUVCompositor::color(boxColor, full_range), boxThickness);
+
+        if (showCrop)
+            compositor.drawRect(frame, cropX, cropY, cropWidth, cropHeight, YUVCompositor::color(cropColor, full_range), cropThickness);
+
+        double maxValue = gridMax();
+        for (size_t i = 0; i < grid.size(); i++) {
+            string color = grid[i].value == maxValue ? "yellow" : "red";
+            compositor.drawText(frame, grid[i].x, grid[i].y, to_string(i) + ":" + grid[i].text,
+                                YUVCompositor::color(color, full_range), 40);
+        }
+
+        if (!captionText.empty())
+            compositor.drawText(frame, 20, frame->height - compositor.textHeight(fontSize) - 20, captionText,
+                                YUVCompositor::color(fontColor, full_range), fontSize);
+
+        if (logoLoaded && logoFrame)
+            compositor.drawLogo(frame, logoFrame, (frame->width - logoFrame->width - 20) & ~1,
+                                (frame->height - logoFrame->height - 20) & ~1);
+
+        return true;
+    }
+
     AVFrame* FrameOverlayProcessor::processFrame(AVFrame* inputFrame) {
 
     cout << "processFrame" << endl;
 
-    if (inputFrame->width != frameWidth || inputFrame->height != frameHeight) {
+    // Size or format changes just change the layer key, the graph is rebuilt once for them
+    if (inputFrame->width != frameWidth || inputFrame->height != frameHeight || inputFrame->format != pixelFormat) {
         frameWidth = inputFrame->width;
         frameHeight = inputFrame->height;
-        initialized = false;
+        pixelFormat = static_cast<AVPixelFormat>(inputFrame->format);
         cout << "processFrame# frame size change to: " << frameWidth << " x " << frameHeight << endl;
-        if (initializeFilterGraph()) 
-            processFrame(inputFrame);
-        else 
-            return nullptr;
     }
+
+    if (!initializeFilterGraph()) return nullptr;
         
     if (!filterGraph) {
         ERROR_PRINT("missing filterGraph");
@@ -0,0 +1,250 @@
+#include <snapshotStore.h>
+#include <algorithm>
+#include <ctime>
+#include <cmath>
+#include <filesystem>
+#include <someLogger.h>
+
+namespace fs = filesystem;
+
+map<string, SnapshotStore*> SnapshotStore::stores;
+mutex SnapshotStore::stores_mutex;
+
+SnapshotStore* SnapshotStore::forCamera(const json& config, const string& camera) {
+
+    if (config.count("store") == 0) return nullptr;
+
+    lock_guard<mutex> lock(stores_mutex);
+    auto& store = stores[camera];
+    if (!store) store = new SnapshotStore(config, camera);
+    return store;
+}
+
+SnapshotStore::SnapshotStore(const json& config, const string& camera) : camera(camera) {
+
+    dir = config["files"].get<string>() + "store/";
+
+    auto jstore = config["store"];
+    if (jstore.is_object()) {
+        dir = jstore.value("dir", dir);
+        max_bytes = static_cast<uint64_t>(jstore.value("max_mb", 1024)) << 20;
+        max_days = max(1, jstore.value("max_days", 14));
+    }
+    dir += camera + "/";
+
+    error_code ec;
+    fs::create_directories(dir, ec);
+
+    // The only directory listing: which days exist, once at startup
+    for (auto& file : fs::directory_iterator(dir, ec)) {
+        if (file.path().extension() != ".idx") continue;
+        try {
+            load(static_cast<uint32_t>(stoul(file.path().stem().string())));
+        } catch (const exception& e) {
+        }
+    }
+
+    lock_guard<mutex> lock(store_mutex);
+    enforceBudget(dayOf(someLogger::timeSinceEpochMilli()));
+}
+
+SnapshotStore::~SnapshotStore() {
+    closeDay();
+}
+
+uint32_t SnapshotStore::dayOf(int64_t time) {
+    time_t seconds = static_cast<time_t>(time / 1000);
+    tm local;
+    localtime_r(&seconds, &local);
+    return static_cast<uint32_t>((local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 + local.tm_mday);
+}
+
+string SnapshotStore::path(uint32_t day, const char *extension) {
+    return dir + to_string(day) + extension;
+}
+
+// Records past the end of the segment (crash between the two writes) and a torn last record are cut off
+// the index, the day is appended to again and new records must start on a record boundary
+void SnapshotStore::load(uint32_t day) {
+
+    error_code ec;
+    uint64_t segment_size = fs::file_size(path(day, ".seg"), ec);
+    if (ec) segment_size = 0;
+
+    FILE *file = fopen(path(day, ".idx").c_str(), "rb");
+    if (!file) return;
+
+    Day loaded;
+    Record record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        // Payloads are appended in order, so the first one missing from the segment starts the torn tail
+        if (record.offset + record.size > segment_size) break;
+        Entry entry;
+        entry.time = record.time;
+        entry.offset = record.offset;
+        entry.size = record.size;
+        entry.iso = record.iso;
+        entry.iris = record.iris;
+        entry.brightness = record.brightness;
+        entry.contrast = record.contrast;
+        entry.exposure = record.exposure;
+        entry.focus = record.focus;
+        entry.day = day;
+        loaded.entries.push_back(entry);
+    }
+    fclose(file);
+
+    uint64_t valid = loaded.entries.size() * sizeof(Record);
+    if (fs::file_size(path(day, ".idx"), ec) != valid) {
+        fs::resize_file(path(day, ".idx"), valid, ec);
+        if (ec) someLogger::getInstance()->log(camera + " snapshot store can not repair " + path(day, ".idx"));
+    }
+
+    sort(loaded.entries.begin(), loaded.entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    loaded.bytes = segment_size + fs::file_size(path(day, ".idx"), ec);
+
+    lock_guard<mutex> lock(store_mutex);
+    total_bytes += loaded.bytes;
+    days[day] = std::move(loaded);
+}
+
+bool SnapshotStore::openDay(uint32_t day) {
+
+    segment = fopen(path(day, ".seg").c_str(), "ab");
+    index = fopen(path(day, ".idx").c_str(), "ab");
+    if (!segment || !index) {
+        someLogger::getInstance()->log(camera + " snapshot store can not open " + path(day, ".seg"));
+        closeDay();
+        return false;
+    }
+    open_day = day;
+    return true;
+}
+
+void SnapshotStore::closeDay() {
+    if (segment) fclose(segment);
+    if (index) fclose(index);
+    segment = nullptr;
+    index = nullptr;
+    open_day = 0;
+}
+
+bool SnapshotStore::append(const Entry& metadata, const vector<uint8_t>& jpeg) {
+
+    if (jpeg.empty()) return false;
+
+    lock_guard<mutex> lock(store_mutex);
+
+    uint32_t day = dayOf(metadata.time);
+    if (day != open_day) {
+        closeDay();
+        if (!openDay(day)) return false;
+    }
+
+    fseek(segment, 0, SEEK_END);
+    long offset = ftell(segment);
+    if (offset < 0) return false;
+
+    // Payload first, so an index record never points at bytes that are not on disk yet
+    if (fwrite(jpeg.data(), 1, jpeg.size(), segment) != jpeg.size()) return false;
+    fflush(segment);
+
+    Entry entry = metadata;
+    entry.offset = static_cast<uint64_t>(offset);
+    entry.size = static_cast<uint32_t>(jpeg.size());
+    entry.day = day;
+
+    Record record = {entry.time, entry.offset, entry.size, entry.iso, entry.iris, entry.brightness,
+                     entry.contrast, entry.exposure, entry.focus, 0};
+    if (fwrite(&record, sizeof(record), 1, index) != 1) return false;
+    fflush(index);
+
+    auto& entries = days[day].entries;
+    if (entries.empty() || entries.back().time <= entry.time) entries.push_back(entry);
+    else entries.insert(upper_bound(entries.begin(), entries.end(), entry,
+                        [](const Entry& a, const Entry& b) { return a.time < b.time; }), entry);
+
+    days[day].bytes += jpeg.size() + sizeof(record);
+    total_bytes += jpeg.size() + sizeof(record);
+
+    enforceBudget(day);
+    return true;
+}
+
+// Drops whole days, oldest first; the day being written is never evicted
+void SnapshotStore::enforceBudget(uint32_t today) {
+
+    uint32_t cutoff = dayOf(someLogger::timeSinceEpochMilli() - static_cast<int64_t>(max_days) * 86400000);
+
+    while (!days.empty()) {
+        auto oldest = days.begin();
+        if (oldest->first == today || oldest->first == open_day) break;
+        if (total_bytes <= max_bytes && oldest->first >= cutoff) break;
+
+        error_code ec;
+        fs::remove(path(oldest->first, ".seg"), ec);
+        fs::remove(path(oldest->first, ".idx"), ec);
+        someLogger::getInstance()->log(camera + " snapshot store evicted " + to_string(oldest->first));
+
+        total_bytes -= min(total_bytes, oldest->second.bytes);
+        days.erase(oldest);
+    }
+}
+
+vector<SnapshotStore::Entry> SnapshotStore::query(int64_t from, int64_t to, size_t limit) {
+
+    vector<Entry> result;
+    if (to < from) return result;
+
+    lock_guard<mutex> lock(store_mutex);
+
+    auto before = [](const Entry& entry, int64_t time) { return entry.time < time; };
+
+    for (auto it = days.lower_bound(dayOf(from)); it != days.end() && it->first <= dayOf(to); ++it) {
+        auto& entries = it->second.entries;
+        for (auto e = lower_bound(entries.begin(), entries.end(), from, before); e != entries.end() && e->time <= to; ++e) {
+            result.push_back(*e);
+            if (result.size() >= limit) return result;
+        }
+    }
+    return result;
+}
+
+bool SnapshotStore::read(const Entry& entry, vector<uint8_t>& jpeg) {
+
+    FILE *file = fopen(path(entry.day, ".seg").c_str(), "rb");
+    if (!file) return false;
+
+    jpeg.resize(entry.size);
+    bool ok = fseek(file, static_cast<long>(entry.offset), SEEK_SET) == 0 &&
+              fread(jpeg.data(), 1, entry.size, file) == entry.size;
+    fclose(file);
+
+    if (!ok) jpeg.clear();
+    return ok;
+}
+
+json SnapshotStore::toJson(const Entry& entry) {
+    auto round2 = [](float value) { return round(value * 100) / 100; };
+    json result;
+    result["time"] = entry.time;
+    result["size"] = entry.size;
+    result["iso"] = entry.iso;
+    result["iris"] = round2(entry.iris);
+    result["brightness"] = round2(entry.brightness);
+    result["contrast"] = round2(entry.contrast);
+    result["exposure"] = round2(entry.exposure);
+    if (entry.focus >= 0) result["focus"] = round2(entry.focus);
+    return result;
+}
+
+json SnapshotStore::status() {
+    lock_guard<mutex> lock(store_mutex);
+    size_t frames = 0;
+    for (auto& day : days) frames += day.second.entries.size();
+    json result;
+    result["store_days"] = days.size();
+    result["store_frames"] = frames;
+    result["store_mb"] = round(total_bytes / 1048576.0 * 10) / 10;
+    return result;
+}
@@ -1,36 +1,370 @@
 #include <someFFMpeg.h>
 #include <iostream>
+#include <map>
+#include <tuple>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <someMetrics.h>
 
-void someFFMpeg::saveAVFrameAsJPEG(AVFrame *frame, const string& path, int quality) {
- 
-    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
-    AVCodecContext *ctx = avcodec_alloc_context3(codec);
-    
-    ctx->width = frame->width;
-    ctx->height = frame->height;
-    ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
-    ctx->time_base = {1, 1};
-    
-    // Minimal settings - avoid buffer/rate completely
-    ctx->flags |= AV_CODEC_FLAG_QSCALE;
-    ctx->global_quality = FF_QP2LAMBDA * (32 - quality * 31 / 100);
-    
-    if (avcodec_open2(ctx, codec, nullptr) >= 0) {
-        AVPacket *pkt = av_packet_alloc();
-        
-        if (avcodec_send_frame(ctx, frame) >= 0 && 
-            avcodec_receive_packet(ctx, pkt) >= 0) {
-            
-            FILE *f = fopen(path.c_str(), "wb");
-            if (f) {
-                fwrite(pkt->data, 1, pkt->size, f);
-                fclose(f);
-                std::cout << "✅ JPEG saved: " << path << std::endl;
+namespace {
+
+typedef tuple<int, int, int, int> EncoderKey;
+
+// Idle encoders by key - a caller checks one out, so concurrent encodes of the same size each get their own
+class EncoderCache {
+    mutex cache_mutex;
+    multimap<EncoderKey, AVCodecContext*> idle;
+public:
+    ~EncoderCache() {
+        for (auto& entry : idle) avcodec_free_context(&entry.second);
+    }
+
+    AVCodecContext* acquire(const EncoderKey& key) {
+        {
+            lock_guard<mutex> lock(cache_mutex);
+            auto it = idle.find(key);
+            if (it != idle.end()) {
+                AVCodecContext *ctx = it->second;
+                idle.erase(it);
+                return ctx;
+            }
+        }
+
+        const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        AVCodecContext *ctx = avcodec_alloc_context3(codec);
+        if (!ctx) return nullptr;
+
+        ctx->width = get<0>(key);
+        ctx->height = get<1>(key);
+        ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        ctx->time_base = {1, 1};
+
+        // Minimal settings - avoid buffer/rate completely
+        ctx->flags |= AV_CODEC_FLAG_QSCALE;
+        ctx->global_quality = FF_QP2LAMBDA * (32 - get<3>(key) * 31 / 100);
+
+        if (avcodec_open2(ctx, codec, nullptr) < 0) {
+            avcodec_free_context(&ctx);
+            return nullptr;
+        }
+        return ctx;
+    }
+
+    void release(const EncoderKey& key, AVCodecContext *ctx) {
+        lock_guard<mutex> lock(cache_mutex);
+        idle.emplace(key, ctx);
+    }
+};
+
+EncoderCache& encoders() {
+    static EncoderCache cache;
+    return cache;
+}
+
+bool writeFile(const string& path, const vector<uint8_t>& data) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+    return true;
+}
+
+// Single background encoder - holds frame references, not copies
+class JpegWriter {
+
+    struct Job {
+        AVFrame *frame;
+        vector<someRendition> renditions;
+        someRenditionSink sink;
+    };
+
+    const size_t MAX_PENDING = 8;
+
+    deque<Job> jobs;
+    mutex jobs_mutex;
+    condition_variable jobs_cv;
+    bool stopping = false;
+    thread worker;
+
+    void drain() {
+        while (true) {
+            Job job;
+            {
+                unique_lock<mutex> lock(jobs_mutex);
+                jobs_cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = jobs.front();
+                jobs.pop_front();
             }
+            someFFMpeg::encodeRenditions(job.frame, job.renditions, job.sink);
+            av_frame_free(&job.frame);
         }
-        
-        av_packet_free(&pkt);
     }
-    
-    avcodec_free_context(&ctx);
+
+public:
+    JpegWriter() : worker(&JpegWriter::drain, this) {}
+
+    ~JpegWriter() {
+        {
+            lock_guard<mutex> lock(jobs_mutex);
+            stopping = true;
+        }
+        jobs_cv.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    void post(AVFrame *frame, const vector<someRendition>& renditions, someRenditionSink sink) {
+        AVFrame *dropped = nullptr;
+        {
+            lock_guard<mutex> lock(jobs_mutex);
+            // A stalled disk must not pin an unbounded number of decoded frames
+            if (jobs.size() >= MAX_PENDING) {
+                dropped = jobs.front().frame;
+                std::cout << "⚠️ JPEG queue full, dropped a frame" << std::endl;
+                jobs.pop_front();
+            }
+            jobs.push_back({frame, renditions, sink});
+        }
+        jobs_cv.notify_one();
+        if (dropped) av_frame_free(&dropped);
+    }
+};
+
+JpegWriter& writer() {
+    static JpegWriter w;
+    return w;
+}
+
+
+// MJPEG takes planar 4:2:0 - NV12 from hardware decode and other layouts are converted first
+const AVFrame* toYUV420(const AVFrame *frame) {
+
+    if (frame->format == AV_PIX_FMT_YUVJ420P || frame->format == AV_PIX_FMT_YUV420P) return frame;
+
+    thread_local SwsContext *sws = nullptr;
+    thread_local AVFrame *converted = nullptr;
+
+    if (!converted) converted = av_frame_alloc();
+    if (!converted) return nullptr;
+
+    if (converted->width != frame->width || converted->height != frame->height) {
+        av_frame_unref(converted);
+        converted->format = AV_PIX_FMT_YUVJ420P;
+        converted->width = frame->width;
+        converted->height = frame->height;
+        if (av_frame_get_buffer(converted, 32) < 0) return nullptr;
+    }
+
+    sws = sws_getCachedContext(sws, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                               frame->width, frame->height, AV_PIX_FMT_YUVJ420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws) return nullptr;
+
+    SOME_TIMED_SCOPE(timer, "saveAVFrameAsJPEG.sws");
+    sws_scale(sws, frame->data, frame->linesize, 0, frame->height, converted->data, converted->linesize);
+    return converted;
+}
+
+}
+
+bool someFFMpeg::encodeJPEG(const AVFrame *input, int quality, vector<uint8_t>& jpeg) {
+
+    const AVFrame *frame = toYUV420(input);
+    if (!frame) return false;
+
+    EncoderKey key(frame->width, frame->height, frame->format, quality);
+    AVCodecContext *ctx = encoders().acquire(key);
+    if (!ctx) return false;
+
+    bool ok = false;
+    thread_local AVPacket *pkt = av_packet_alloc();
+    thread_local AVFrame *ref = av_frame_alloc();
+
+    // A cached context remembers the last pts and rejects anything not after it (snapshots of another
+    // camera, a reconnected stream), so the encoder sees no pts and numbers the frames itself
+    if (av_frame_ref(ref, frame) >= 0) {
+        ref->pts = AV_NOPTS_VALUE;
+        if (avcodec_send_frame(ctx, ref) >= 0 &&
+            avcodec_receive_packet(ctx, pkt) >= 0) {
+            jpeg.assign(pkt->data, pkt->data + pkt->size);
+            ok = true;
+        }
+        av_frame_unref(ref);
+    }
+
+    av_packet_unref(pkt);
+
+    // A context that failed mid-encode may hold state, only healthy ones go back to the cache
+    if (ok) encoders().release(key, ctx);
+    else avcodec_free_context(&ctx);
+
+    return ok;
+}
+
+bool someFFMpeg::saveAVFrameAsJPEG(AVFrame *frame, const string& path, int quality) {
+
+    SOME_TIMED_SCOPE(timer, "saveAVFrameAsJPEG");
+
+    vector<uint8_t> jpeg;
+    if (!encodeJPEG(frame, quality, jpeg) || !writeFile(path, jpeg)) return false;
+    std::cout << "✅ JPEG saved: " << path << std::endl;
+    return true;
+}
+
+someDecoderOptions someFFMpeg::decoderOptions(const nlohmann::json& config, int cam_idx) {
+
+    someDecoderOptions options;
+    if (config.count("decoder") == 0) return options;
+
+    auto jdecoder = config["decoder"];
+    if (jdecoder.is_array()) {
+        if (jdecoder.empty()) return options;
+        jdecoder = jdecoder[min(cam_idx, static_cast<int>(jdecoder.size()) - 1)];
+    }
+    if (!jdecoder.is_object()) return options;
+
+    options.threads = max(0, jdecoder.value("threads", options.threads));
+    options.low_delay = jdecoder.value("low_delay", options.low_delay);
+    options.max_delay_ms = max(0, jdecoder.value("max_delay_ms", options.low_delay ? 500 : options.max_delay_ms));
+
+    // "frame" pipelines whole pictures (a frame of latency per thread), "slice" splits each picture
+    // and only helps when the encoder writes several slices
+    string type = jdecoder.value("thread_type", string("auto"));
+    if (type == "frame") options.thread_type = FF_THREAD_FRAME;
+    else if (type == "slice") options.thread_type = FF_THREAD_SLICE;
+
+    return options;
+}
+
+AVCodecContext* someFFMpeg::openDecoder(const AVCodecParameters *codecpar, const someDecoderOptions& options,
+                                         const function<bool(AVCodecContext *ctx)>& configure) {
+
+    // The RTSP demuxer fills codecpar from the SDP, so sprop-parameter-sets arrive as extradata
+    enum AVCodecID id = codecpar && codecpar->codec_id != AV_CODEC_ID_NONE ? codecpar->codec_id : AV_CODEC_ID_H264;
+    const AVCodec *codec = avcodec_find_decoder(id);
+    if (!codec) return nullptr;
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) return nullptr;
+
+    if (codecpar && avcodec_parameters_to_context(ctx, codecpar) < 0) {
+        avcodec_free_context(&ctx);
+        return nullptr;
+    }
+    ctx->codec_type = AVMEDIA_TYPE_VIDEO;
+    ctx->codec_id = id;
+
+    ctx->thread_count = options.threads;
+    ctx->thread_type = options.thread_type;
+    if (options.low_delay) ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+    if ((configure && !configure(ctx)) || avcodec_open2(ctx, codec, nullptr) < 0) {
+        avcodec_free_context(&ctx);
+        return nullptr;
+    }
+    return ctx;
+}
+
+vector<someRendition> someFFMpeg::renditions(const nlohmann::json& config) {
+
+    vector<someRendition> result;
+
+    if (config.count("renditions") > 0)
+        for (auto& jrendition : config["renditions"]) {
+            someRendition rendition;
+            rendition.width = jrendition.value("width", 0);
+            rendition.name = jrendition.value("name", rendition.width > 0 ? to_string(rendition.width) : string("full"));
+            rendition.quality = jrendition.value("quality", rendition.width > 0 ? 85 : 100);
+            result.push_back(rendition);
+        }
+
+    if (result.empty()) result.push_back(someRendition());
+    return result;
+}
+
+string someFFMpeg::renditionPath(const string& base, const someRendition& rendition) {
+    return rendition.width > 0 ? base + "_" + rendition.name + ".JPG" : base + ".JPG";
+}
+
+const AVFrame* someFFMpeg::scaleFrame(const AVFrame *frame, int width) {
+
+    struct Scaler {
+        SwsContext *sws = nullptr;
+        AVFrame *scaled = nullptr;
+    };
+    typedef tuple<int, int, int, int> ScalerKey;
+
+    // Few distinct sizes ever show up, so the cache just grows to one entry per rendition
+    thread_local map<ScalerKey, Scaler> scalers;
+
+    width &= ~1;
+    int height = (static_cast<int64_t>(frame->height) * width / frame->width) & ~1;
+    if (width <= 0 || height <= 0) return nullptr;
+
+    auto& scaler = scalers[ScalerKey(frame->width, frame->height, frame->format, width)];
+
+    if (!scaler.scaled) {
+        scaler.scaled = av_frame_alloc();
+        if (!scaler.scaled) return nullptr;
+        scaler.scaled->format = AV_PIX_FMT_YUVJ420P;
+        scaler.scaled->width = width;
+        scaler.scaled->height = height;
+        if (av_frame_get_buffer(scaler.scaled, 32) < 0) {
+            av_frame_free(&scaler.scaled);
+            return nullptr;
+        }
+        scaler.sws = sws_getContext(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                    width, height, AV_PIX_FMT_YUVJ420P, SWS_AREA, nullptr, nullptr, nullptr);
+    }
+    if (!scaler.sws) return nullptr;
+
+    SOME_TIMED_SCOPE(timer, "saveAVFrameAsJPEG.scale");
+    sws_scale(scaler.sws, frame->data, frame->linesize, 0, frame->height, scaler.scaled->data, scaler.scaled->linesize);
+    return scaler.scaled;
+}
+
+// Every rendition from the one decoded frame; the full size one skips scaling entirely
+void someFFMpeg::encodeRenditions(const AVFrame *frame, const vector<someRendition>& renditions, const someRenditionSink& sink) {
+
+    SOME_TIMED_SCOPE(timer, "saveAVFrameAsJPEG");
+
+    for (auto& rendition : renditions) {
+        const AVFrame *output = rendition.width > 0 && rendition.width < frame->width ? scaleFrame(frame, rendition.width) : frame;
+        if (!output) continue;
+        vector<uint8_t> jpeg;
+        if (encodeJPEG(output, rendition.quality, jpeg)) sink(rendition, jpeg);
+    }
+}
+
+void someFFMpeg::encodeRenditionsAsync(const AVFrame *frame, const vector<someRendition>& renditions, someRenditionSink sink) {
+
+    AVFrame *ref = av_frame_clone(frame);
+    if (!ref) return;
+    writer().post(ref, renditions, sink);
+}
+
+namespace {
+
+someRenditionSink fileSink(const string& base) {
+    return [base](const someRendition& rendition, const vector<uint8_t>& jpeg) {
+        string path = someFFMpeg::renditionPath(base, rendition);
+        if (writeFile(path, jpeg)) std::cout << "✅ JPEG saved: " << path << std::endl;
+    };
+}
+
+}
+
+bool someFFMpeg::writeJPEG(const string& path, const vector<uint8_t>& jpeg) {
+    if (!writeFile(path, jpeg)) return false;
+    std::cout << "✅ JPEG saved: " << path << std::endl;
+    return true;
+}
+
+void someFFMpeg::saveRenditions(const AVFrame *frame, const string& base, const vector<someRendition>& renditions) {
+    encodeRenditions(frame, renditions, fileSink(base));
+}
+
+void someFFMpeg::saveRenditionsAsync(const AVFrame *frame, const string& base, const vector<someRendition>& renditions) {
+    encodeRenditionsAsync(frame, renditions, fileSink(base));
 }
@@ -11,8 +11,11 @@
 someLogger *someLogger::_instance;
 
 someLogger *someLogger::getInstance(string filename, someLogLevel level) {
-    if (_instance == nullptr)
+    if (_instance == nullptr) {
         _instance = new someLogger(filename, level);
+        // Whatever is still queued at exit gets written
+        atexit([]() { if (_instance) _instance->close(); });
+    }
     return _instance;
 }
 
@@ -20,33 +23,142 @@ someLogger *someLogger::getInstance() {
     return _instance;
 }
 
-someLogger::someLogger(string filename, someLogLevel level) {
+someLogger::someLogger(string filename, someLogLevel level) : path(filename) {
     fp = fopen(filename.c_str(), "w");
     defaultLogLevel = level;
+    ring.reset(new Entry[RING_SIZE]);
+    for (size_t i = 0; i < RING_SIZE; i++) ring[i].seq.store(i, std::memory_order_relaxed);
+    writer = thread(&someLogger::drain, this);
 }
 
 void someLogger::log(string message, Colors color, someLogLevel override) {
     someLogLevel level = override == someLogLevel::DEFAULT ? defaultLogLevel : override;
-    // timeStamp
+    enqueue(std::move(message), level == someLogLevel::DEBUG);
+}
+
+bool someLogger::enqueue(string&& message, bool echo) {
+
     uint64_t ts = timeSinceEpochMilli();
-    // uint64_t diff = last > 0 ? ts - last : 0;
-    // if (last > 0) fprintf(fp, "+");
-    auto dateString = getCurrentDateString();
-    last = ts;
-    fprintf(fp, "%s: %s\n", dateString.c_str(), message.c_str());
-    fflush(fp);
-    if (level == someLogLevel::DEBUG) {
+
+    int rate = max_rate.load(std::memory_order_relaxed);
+    if (rate > 0) {
+        int64_t second = static_cast<int64_t>(ts / 1000);
+        int64_t current = rate_second.load(std::memory_order_relaxed);
+        if (current != second && rate_second.compare_exchange_strong(current, second))
+            rate_count.store(0, std::memory_order_relaxed);
+        if (rate_count.fetch_add(1, std::memory_order_relaxed) >= rate) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    Entry *entry;
+    uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        entry = &ring[pos & (RING_SIZE - 1)];
+        uint64_t seq = entry->seq.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // Writer is a full ring behind, never stall the caller
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->ts = ts;
+    entry->echo = echo;
+    entry->message = std::move(message);
+    entry->seq.store(pos + 1, std::memory_order_release);
+
+    wake_cv.notify_one();
+    return true;
+}
+
+void someLogger::drain() {
+
+    while (true) {
+
+        bool wrote = false;
+        while (true) {
+            Entry &entry = ring[dequeue_pos & (RING_SIZE - 1)];
+            if (entry.seq.load(std::memory_order_acquire) != dequeue_pos + 1) break;
+            write(entry);
+            entry.message.clear();
+            entry.seq.store(dequeue_pos + RING_SIZE, std::memory_order_release);
+            dequeue_pos++;
+            wrote = true;
+        }
+
+        uint64_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost != dropped_reported && fp) {
+            fprintf(fp, "%s: [LOGGER] %llu messages dropped\n", cached_stamp, static_cast<unsigned long long>(lost - dropped_reported));
+            dropped_reported = lost;
+            wrote = true;
+        }
+
+        // One flush per batch instead of per message
+        if (wrote && fp) fflush(fp);
+
+        if (!running) {
+            if (enqueue_pos.load() == dequeue_pos) break;
+            continue;
+        }
+
+        // notify_one() comes without the mutex, the timeout bounds a missed wakeup
+        unique_lock<mutex> lock(wake_mutex);
+        wake_cv.wait_for(lock, chrono::milliseconds(100));
+    }
+}
+
+void someLogger::write(const Entry& entry) {
+
+    time_t second = static_cast<time_t>(entry.ts / 1000);
+    if (second != cached_second) {
+        strftime(cached_stamp, sizeof(cached_stamp), "%Y-%m-%d %H:%M:%S", localtime(&second));
+        cached_second = second;
+    }
+    last = entry.ts;
+
+    if (fp) {
+        int n = fprintf(fp, "%s: %s\n", cached_stamp, entry.message.c_str());
+        if (n > 0) written += n;
+        if (max_bytes > 0 && written >= max_bytes) rotate();
+    }
+
+    if (entry.echo) {
 //        fprintf(stdout, "\033[1;%dm", color);
-        fprintf(stdout, "%s\n", message.c_str());
+        fprintf(stdout, "%s\n", entry.message.c_str());
     }
 }
 
+void someLogger::rotate() {
+    fclose(fp);
+    for (int i = keep - 1; i >= 1; i--)
+        std::rename((path + "." + to_string(i)).c_str(), (path + "." + to_string(i + 1)).c_str());
+    if (keep > 0) std::rename(path.c_str(), (path + ".1").c_str());
+    fp = fopen(path.c_str(), "w");
+    written = 0;
+}
+
+void someLogger::setRotation(size_t bytes, int files) {
+    max_bytes = bytes;
+    keep = max(0, files);
+}
+
 void someLogger::error(string message) {
     log("[ERROR] " + message);
 }
 
 void someLogger::close() {
-    fclose(fp);
+    if (!running.exchange(false)) return;
+    wake_cv.notify_one();
+    if (writer.joinable()) writer.join();
+    if (fp) fclose(fp);
+    fp = nullptr;
 }
 
 time_t someLogger::fileTimeToTimeT(const fs::file_time_type& ftime) {
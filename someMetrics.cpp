@@ -0,0 +1,167 @@
+#include <someMetrics.h>
+#include <someLogger.h>
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+namespace {
+
+struct Registry {
+    mutex registry_mutex;
+    map<string, unique_ptr<someHistogram>> histograms;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+}
+
+someHistogram::someHistogram(const string& name) : name(name) {
+    for (auto& count : counts) count.store(0, std::memory_order_relaxed);
+}
+
+int someHistogram::bucket(uint64_t us) {
+    if (us < 8) return static_cast<int>(us);
+    int exponent = 63 - __builtin_clzll(us);
+    int sub = static_cast<int>((us >> (exponent - 3)) & 7);
+    return 8 + (exponent - 3) * 8 + sub;
+}
+
+double someHistogram::midpoint(int index) {
+    if (index < 8) return index;
+    int exponent = (index - 8) / 8 + 3;
+    int sub = (index - 8) % 8;
+    double width = static_cast<double>(uint64_t(1) << (exponent - 3));
+    return (8 + sub) * width + width / 2;
+}
+
+void someHistogram::record(uint64_t us) {
+    counts[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(us, std::memory_order_relaxed);
+    uint64_t current = peak.load(std::memory_order_relaxed);
+    while (us > current && !peak.compare_exchange_weak(current, us, std::memory_order_relaxed));
+}
+
+// Read without stopping writers - a sample landing mid-walk only nudges the result by one bucket
+double someHistogram::percentile(double p) const {
+    uint64_t n = 0;
+    for (auto& count : counts) n += count.load(std::memory_order_relaxed);
+    if (n == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(p * (n - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(midpoint(i), static_cast<double>(peak.load(std::memory_order_relaxed)));
+    }
+    return static_cast<double>(peak.load(std::memory_order_relaxed));
+}
+
+json someHistogram::summary() const {
+    auto round_ms = [](double us) { return std::round(us / 10.0) / 100.0; };
+    uint64_t n = count();
+    json result;
+    result["count"] = n;
+    result["mean_ms"] = n ? round_ms(static_cast<double>(sumMicros()) / n) : 0.0;
+    result["p50_ms"] = round_ms(percentile(0.50));
+    result["p90_ms"] = round_ms(percentile(0.90));
+    result["p99_ms"] = round_ms(percentile(0.99));
+    result["max_ms"] = round_ms(static_cast<double>(peak.load(std::memory_order_relaxed)));
+    return result;
+}
+
+someHistogram& someMetrics::histogram(const string& name) {
+    auto& reg = registry();
+    lock_guard<mutex> lock(reg.registry_mutex);
+    auto& entry = reg.histograms[name];
+    if (!entry) entry.reset(new someHistogram(name));
+    return *entry;
+}
+
+json someMetrics::snapshot() {
+    auto& reg = registry();
+    lock_guard<mutex> lock(reg.registry_mutex);
+    json result = json::object();
+    for (auto& entry : reg.histograms)
+        if (entry.second->count() > 0) result[entry.first] = entry.second->summary();
+    return result;
+}
+
+string someMetrics::prometheus() {
+    auto& reg = registry();
+    lock_guard<mutex> lock(reg.registry_mutex);
+
+    stringstream ss;
+    ss << std::setprecision(6);
+    ss << "# HELP zcam_stage_seconds Wall time per pipeline stage\n";
+    ss << "# TYPE zcam_stage_seconds summary\n";
+    for (auto& entry : reg.histograms) {
+        auto& h = *entry.second;
+        uint64_t n = h.count();
+        if (n == 0) continue;
+        string label = "stage=\"" + entry.first + "\"";
+        for (double q : {0.5, 0.9, 0.99})
+            ss << "zcam_stage_seconds{" << label << ",quantile=\"" << q << "\"} " << h.percentile(q) / 1e6 << "\n";
+        ss << "zcam_stage_seconds_sum{" << label << "} " << h.sumMicros() / 1e6 << "\n";
+        ss << "zcam_stage_seconds_count{" << label << "} " << n << "\n";
+    }
+    return ss.str();
+}
+
+// One request per connection, scrapes are rare and tiny so a blocking accept loop is enough
+void someMetrics::serve(int port, const string& address) {
+
+    thread([port, address]() {
+        try {
+            net::io_context ioc;
+            tcp::acceptor acceptor(ioc, {net::ip::make_address(address), static_cast<unsigned short>(port)});
+            someLogger::getInstance()->log("metrics listening on " + address + ":" + to_string(port));
+
+            while (true) {
+                tcp::socket socket(ioc);
+                acceptor.accept(socket);
+                try {
+                    beast::flat_buffer buffer;
+                    http::request<http::empty_body> req;
+                    http::read(socket, buffer, req);
+
+                    http::response<http::string_body> res;
+                    res.version(req.version());
+                    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+                    if (req.target() == "/metrics" || req.target() == "/") {
+                        res.result(http::status::ok);
+                        res.set(http::field::content_type, "text/plain; version=0.0.4");
+                        res.body() = prometheus();
+                    } else {
+                        res.result(http::status::not_found);
+                    }
+                    res.keep_alive(false);
+                    res.prepare_payload();
+                    http::write(socket, res);
+
+                    beast::error_code ec;
+                    socket.shutdown(tcp::socket::shutdown_send, ec);
+                } catch (std::exception const& e) {
+                    // A scraper that hung up mid-request is not our problem
+                }
+            }
+        } catch (std::exception const& e) {
+            someLogger::getInstance()->log(string("metrics server failed: ") + e.what());
+        }
+    }).detach();
+}
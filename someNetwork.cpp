@@ -4,6 +4,7 @@
 
 #include <someNetwork.h>
 #include <someLogger.h>
+#include <someMetrics.h>
 
 #include "root_certificates.hpp"
 
@@ -17,6 +18,11 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <sstream>
 
 typedef unsigned char uchar;
 
@@ -24,6 +30,155 @@ namespace net = boost::asio;        // from <boost/asio.hpp>
 namespace ssl = net::ssl;           // from <boost/asio/ssl.hpp>
 using tcp = net::ip::tcp;           // from <boost/asio/ip/tcp.hpp>
 
+namespace {
+
+using ssl_stream = beast::ssl_stream<beast::tcp_stream>;
+using steady_clock = std::chrono::steady_clock;
+
+const auto IDLE_TIMEOUT = std::chrono::seconds(30);   // drop keep-alive connections idle longer than this
+const auto DNS_TTL = std::chrono::minutes(5);
+const size_t MAX_IDLE_PER_HOST = 4;
+
+// One HTTPS connection on an io_context of its own. tcp_stream deadlines only govern async operations,
+// so each blocking step is started as one and run to completion here, the deadline closing the socket.
+struct HttpsConnection {
+    net::io_context ioc;
+    ssl_stream stream;
+
+    explicit HttpsConnection(ssl::context& ctx) : stream(ioc, ctx) {}
+
+    // start(handler) begins the operation; gives up with beast::error::timeout after seconds
+    template <class Start>
+    beast::error_code run(int seconds, Start start) {
+        beast::error_code result;
+        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(seconds));
+        start([&result](beast::error_code ec, auto&&...) { result = ec; });
+        ioc.restart();
+        ioc.run();
+        return result;
+    }
+
+    template <class Start>
+    void await(int seconds, Start start) {
+        auto ec = run(seconds, start);
+        if (ec) throw beast::system_error{ec};
+    }
+};
+
+// Process-wide HTTPS client state: one SSL context with the root certificates loaded once,
+// cached DNS answers, TLS sessions for resumption and idle keep-alive connections per host
+class HttpsPool {
+
+    struct Idle {
+        std::unique_ptr<HttpsConnection> conn;
+        steady_clock::time_point since;
+    };
+
+    struct Resolved {
+        tcp::resolver::results_type results;
+        steady_clock::time_point expires;
+    };
+
+    net::io_context ioc;
+    ssl::context ctx{ssl::context::tlsv12_client};
+    std::mutex pool_mutex;
+    std::map<string, Resolved> dns;
+    std::map<string, SSL_SESSION*> sessions;
+    std::map<string, std::vector<Idle>> idle;
+
+    HttpsPool() {
+        load_root_certificates(ctx);
+        ctx.set_verify_mode(ssl::verify_peer);
+    }
+
+    ~HttpsPool() {
+        for (auto& [key, session] : sessions) SSL_SESSION_free(session);
+    }
+
+    tcp::resolver::results_type resolve(const string& host, const string& port) {
+        auto key = host + ":" + port;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            auto it = dns.find(key);
+            if (it != dns.end() && steady_clock::now() < it->second.expires) return it->second.results;
+        }
+        tcp::resolver resolver(ioc);
+        auto results = resolver.resolve(host, port);
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        dns[key] = {results, steady_clock::now() + DNS_TTL};
+        return results;
+    }
+
+public:
+
+    static HttpsPool& instance() {
+        static HttpsPool pool;
+        return pool;
+    }
+
+    std::unique_ptr<HttpsConnection> reuse(const string& host, const string& port) {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        auto& streams = idle[host + ":" + port];
+        while (!streams.empty()) {
+            auto entry = std::move(streams.back());
+            streams.pop_back();
+            if (steady_clock::now() - entry.since < IDLE_TIMEOUT) return std::move(entry.conn);
+        }
+        return nullptr;
+    }
+
+    std::unique_ptr<HttpsConnection> connect(const string& host, const string& port) {
+
+        auto key = host + ":" + port;
+        auto conn = std::make_unique<HttpsConnection>(ctx);
+        auto& stream = conn->stream;
+
+        // Set SNI Hostname (many hosts need this to handshake successfully)
+        if(! SSL_set_tlsext_host_name(stream.native_handle(), host.c_str()))
+        {
+            beast::error_code ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
+            throw beast::system_error{ec};
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            auto it = sessions.find(key);
+            if (it != sessions.end()) SSL_set_session(stream.native_handle(), it->second);
+        }
+
+        try {
+            auto results = resolve(host, port);
+            conn->await(30, [&](auto handler) { beast::get_lowest_layer(stream).async_connect(results, handler); });
+        }
+        catch (beast::system_error const&) {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            dns.erase(key);   // the cached address may be stale
+            throw;
+        }
+
+        conn->await(30, [&](auto handler) { stream.async_handshake(ssl::stream_base::client, handler); });
+
+        return conn;
+    }
+
+    void release(const string& host, const string& port, std::unique_ptr<HttpsConnection> conn) {
+        auto key = host + ":" + port;
+        beast::get_lowest_layer(conn->stream).expires_never();
+        // TLS 1.3 tickets arrive after the handshake, so the session is saved once a response was read
+        SSL_SESSION *session = SSL_get1_session(conn->stream.native_handle());
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (session) {
+            auto it = sessions.find(key);
+            if (it != sessions.end()) SSL_SESSION_free(it->second);
+            sessions[key] = session;
+        }
+        auto& streams = idle[key];
+        if (streams.size() < MAX_IDLE_PER_HOST) streams.push_back({std::move(conn), steady_clock::now()});
+    }
+};
+
+}
+
 
 string someNetwork::urlencode(const std::string &s)
 {
@@ -71,8 +226,50 @@ uint someNetwork::parse_response(http::response<http::dynamic_body> res, bool ve
 }
 
 
+// Sends req over a pooled keep-alive connection. A reused connection the server already closed is
+// retried once on a fresh one. Throws beast::system_error on failure.
+http::response<http::dynamic_body> someNetwork::https_exchange(const string& host, const string& port,
+                                                               http::request<http::string_body>& req, int timeout) {
+
+    SOME_TIMED_SCOPE(timer, "someNetwork.https");
+
+    auto& pool = HttpsPool::instance();
+
+    for (int attempt = 0; ; attempt++) {
+
+        auto conn = attempt == 0 ? pool.reuse(host, port) : nullptr;
+        bool reused = conn != nullptr;
+        if (!conn) conn = pool.connect(host, port);
+        auto& stream = conn->stream;
+
+        try {
+            req.keep_alive(true);
+
+            conn->await(30, [&](auto handler) { http::async_write(stream, req, handler); });
+
+            beast::flat_buffer buffer;
+            http::response<http::dynamic_body> res;
+            conn->await(timeout, [&](auto handler) { http::async_read(stream, buffer, res, handler); });
+
+            if (res.keep_alive()) {
+                pool.release(host, port, std::move(conn));
+            } else {
+                conn->run(5, [&](auto handler) { stream.async_shutdown(handler); });
+            }
+
+            return res;
+        }
+        catch (beast::system_error const& se) {
+            if (reused && attempt == 0 && se.code() != beast::error::timeout) continue;
+            throw;
+        }
+    }
+}
+
 someNetwork::Response someNetwork::http_get(string host, string url, string port) {
 
+    SOME_TIMED_SCOPE(timer, "someNetwork.http");
+
     Response response;
 
     try {
@@ -133,6 +330,8 @@ someNetwork::Response someNetwork::http_request(string host, string url, http::v
     if (log)
         std::cout << "http_request# " << url << " " << method << " " << params << std::endl;
 
+    SOME_TIMED_SCOPE(timer, "someNetwork.http");
+
     Response response;
 
     try {
@@ -427,68 +626,24 @@ someNetwork::Response someNetwork::https_get(string host, string url, string aut
     Response response;
 
     try {
-        net::io_context ioc;
-        ssl::context ctx(ssl::context::sslv23_client);
-        load_root_certificates(ctx);
-        ctx.set_verify_mode(ssl::verify_peer);
-        
-        tcp::resolver resolver(ioc);
-        beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
-        
-        // Set SNI
-        if(!SSL_set_tlsext_host_name(stream.native_handle(), host.c_str())) {
-            beast::error_code ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
-            throw beast::system_error{ec};
-        }
-        
-        // Resolve with timeout
-        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
-        auto const results = resolver.resolve(host, port);
-        
-        // Connect with timeout
-        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
-        beast::get_lowest_layer(stream).connect(results);
-        
-        // SSL handshake with timeout
-        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
-        stream.handshake(ssl::stream_base::client);
-        
-        // HTTP write with timeout
-        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
         http::request<http::string_body> req{http::verb::get, url, 11};
         req.set(http::field::host, host);
         req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
         if (!authorization.empty())
             req.set(http::field::authorization, authorization);
         req.prepare_payload();
-        http::write(stream, req);
-        
-        // HTTP read with timeout
-        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(60));
-        beast::flat_buffer buffer;
-        http::response<http::dynamic_body> res;
-        http::read(stream, buffer, res);
-        
-        // Disable timeout after success
-        beast::get_lowest_layer(stream).expires_never();
+
+        auto res = https_exchange(host, port, req, 60);
         
         // Process response...
         response.str = boost::beast::buffers_to_string(res.body().data());
         response.status = parse_response(res);
         if (!response.str.empty())
             response.json = nlohmann::json::parse(response.str);
-        
-        // Clean shutdown
-        beast::error_code ec;
-        stream.shutdown(ec);
-        if(ec == net::error::eof || ec == ssl::error::stream_truncated) {
-            ec = {};
-        }
-        if(ec) {
-            std::cerr << "Stream error# " << ec << std::endl;
-        }
     }
     catch(beast::system_error const& se) {
+        // A long poll that saw no request within the read timeout
+        if (se.code() == beast::error::timeout) response.timeout = true;
         std::cerr << "Error: " << se.code().message() << std::endl;
     }
 
@@ -603,43 +758,9 @@ someNetwork::Response someNetwork::https_request(string host, string url, http::
     
     Response response;
 
-    // The io_context is required for all I/O
-    net::io_context ioc;
-
     try {
 
-
-        // The SSL context is required, and holds certificates
-        ssl::context ctx(ssl::context::tlsv12_client);
-
-        // This holds the root certificate used for verification
-        load_root_certificates(ctx);
-
-        // Verify the remote server's certificate
-        ctx.set_verify_mode(ssl::verify_peer);
-
-        // These objects perform our I/O
-        tcp::resolver resolver(ioc);
-//        beast::tcp_stream stream(ioc);
-        beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
-
-        // Set SNI Hostname (many hosts need this to handshake successfully)
-        if(! SSL_set_tlsext_host_name(stream.native_handle(), host.c_str()))
-        {
-            beast::error_code ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
-            throw beast::system_error{ec};
-        }
-
-        // Look up the domain name
-        auto const results = resolver.resolve(host, port);
-
-        // Make the connection on the IP address we get from a lookup
-        beast::get_lowest_layer(stream).connect(results);
-
-        // Perform the SSL handshake
-        stream.handshake(ssl::stream_base::client);
-
-        // Set up an HTTP GET request message
+        // Set up an HTTP request message
         http::request<http::string_body> req{method, url, 11};
 
         req.set(http::field::host, host);
@@ -653,32 +774,22 @@ someNetwork::Response someNetwork::https_request(string host, string url, http::
 
         req.prepare_payload();
 
-        // Send the HTTP request to the remote host
-        http::write(stream, req);
-
-        // This buffer is used for reading and must be persisted
-        beast::flat_buffer buffer;
-
-        // Declare a container to hold the response
-        http::response<http::dynamic_body> res;
-
-        // Receive the HTTP response
-        http::read(stream, buffer, res);
+        auto res = https_exchange(host, port, req);
 
         response.str = boost::beast::buffers_to_string(res.body().data());
 
+        response.status = parse_response(res);
+
         if (!response.str.empty())
             response.json = nlohmann::json::parse(response.str);
-
-        parse_response(res);
     }
     catch(std::exception const& e)
     {
+        // Transport failures must not look like a 200, the uploader retries on them
+        if (response.str.empty()) response.status = 0;
         someLogger::getInstance()->log("https_request# " + host + " " + url + " error# " + e.what());
     }
 
-    ioc.run();
-
     return response;
 }
 
@@ -767,4 +878,137 @@ bool someNetwork::https_download(string host, string url, string path, string au
         return false;
     }
 
-}
\ No newline at end of file
+}
+bool someNetwork::https_events(string host, string url, function<bool(const string&)> on_event, string authorization,
+                               string port, int idle_timeout) {
+
+    bool streaming = false;
+
+    try {
+        // A dedicated connection - it stays busy for the life of the stream, so it never goes back to the pool
+        auto conn = HttpsPool::instance().connect(host, port);
+        auto& stream = conn->stream;
+
+        http::request<http::string_body> req{http::verb::get, url, 11};
+        req.set(http::field::host, host);
+        req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+        req.set(http::field::accept, "text/event-stream");
+        req.set(http::field::cache_control, "no-cache");
+        if (!authorization.empty())
+            req.set(http::field::authorization, authorization);
+
+        conn->await(30, [&](auto handler) { http::async_write(stream, req, handler); });
+
+        beast::flat_buffer buffer;
+        http::response_parser<http::buffer_body> parser;
+        parser.body_limit((std::numeric_limits<std::uint64_t>::max)());
+
+        conn->await(idle_timeout, [&](auto handler) { http::async_read_header(stream, buffer, parser, handler); });
+
+        auto& res = parser.get();
+        if (res.result() != http::status::ok ||
+            string(res[http::field::content_type]).find("text/event-stream") == string::npos) return false;
+
+        streaming = true;
+        someLogger::getInstance()->log("https_events# " + host + " " + url + " connected");
+
+        string pending;
+        char chunk[4096];
+
+        while (!parser.is_done()) {
+
+            res.body().data = chunk;
+            res.body().size = sizeof(chunk);
+
+            // Completes on whatever arrived, so the deadline measures silence: only a stream that sent
+            // nothing, not even a keepalive comment, for idle_timeout is treated as dead
+            auto ec = conn->run(idle_timeout, [&](auto handler) { http::async_read_some(stream, buffer, parser, handler); });
+            if (ec == http::error::need_buffer) ec = {};
+
+            // Bytes that arrived with an error are still events
+            for (size_t i = 0; i < sizeof(chunk) - res.body().size; i++)
+                if (chunk[i] != '\r') pending.push_back(chunk[i]);
+
+            // Events end with a blank line; only data fields matter, multi-line data is joined with newlines
+            size_t end;
+            while ((end = pending.find("\n\n")) != string::npos) {
+                stringstream lines(pending.substr(0, end));
+                pending.erase(0, end + 2);
+                string line, data;
+                while (getline(lines, line)) {
+                    if (line.compare(0, 5, "data:") != 0) continue;
+                    if (!data.empty()) data += "\n";
+                    data += line.substr(line.size() > 5 && line[5] == ' ' ? 6 : 5);
+                }
+                if (!data.empty() && !on_event(data)) return true;
+            }
+
+            if (ec) throw beast::system_error{ec};
+        }
+    }
+    catch (std::exception const& e) {
+        someLogger::getInstance()->log("https_events# " + host + " " + url + " error# " + e.what());
+    }
+
+    return streaming;
+}
+
+someNetwork::Response someNetwork::https_stream(string host, string url, http::verb method, const string& content_type,
+                                                function<bool(string& chunk)> next, string authorization, string port) {
+
+    SOME_TIMED_SCOPE(timer, "someNetwork.https_stream");
+
+    someLogger::getInstance()->log("https_stream# " + host + " " + url);
+
+    Response response;
+
+    try {
+        // Its own connection: a half-sent chunked body can not be retried on a fresh one like https_exchange does
+        auto& pool = HttpsPool::instance();
+        auto conn = pool.connect(host, port);
+        auto& stream = conn->stream;
+
+        http::request<http::empty_body> req{method, url, 11};
+        req.set(http::field::host, host);
+        req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+        req.set(http::field::content_type, content_type);
+        if (!authorization.empty())
+            req.set(http::field::authorization, authorization);
+        req.keep_alive(true);
+        req.chunked(true);
+
+        http::request_serializer<http::empty_body> serializer{req};
+        conn->await(30, [&](auto handler) { http::async_write_header(stream, serializer, handler); });
+
+        string chunk;
+        while (next(chunk)) {
+            if (chunk.empty()) continue;
+            auto body = http::make_chunk(net::buffer(chunk));
+            conn->await(30, [&](auto handler) { net::async_write(stream, body, handler); });
+            chunk.clear();
+        }
+        auto last = http::make_chunk_last();
+        conn->await(30, [&](auto handler) { net::async_write(stream, last, handler); });
+
+        beast::flat_buffer buffer;
+        http::response<http::dynamic_body> res;
+        conn->await(60, [&](auto handler) { http::async_read(stream, buffer, res, handler); });
+
+        response.str = boost::beast::buffers_to_string(res.body().data());
+        response.status = parse_response(res);
+        if (!response.str.empty()) {
+            try {
+                response.json = nlohmann::json::parse(response.str);
+            } catch (exception const& e) {
+            }
+        }
+
+        if (res.keep_alive()) pool.release(host, port, std::move(conn));
+    }
+    catch (std::exception const& e) {
+        response.status = 0;
+        someLogger::getInstance()->log("https_stream# " + host + " " + url + " error# " + e.what());
+    }
+
+    return response;
+}
@@ -7,6 +7,7 @@
 #include <filesystem>
 #include <thread>
 #include <chrono>
+#include <future>
 
 namespace fs = std::filesystem;
 
@@ -15,18 +16,141 @@ const std::string b = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz01234
 const string SESSIONS = "/home/surfai/files/sessions/"; // TODO: load from config file
 const string CACHE = "/home/surfai/files/cache/"; // TODO: load from config file
 
-someService::someService(json config, string serviceName) {
+const auto PUSH_RETRY = std::chrono::minutes(10);
+const int MAX_BACKOFF = 60;   // seconds
+
+someService::someService(json config, string serviceName, ZCAM *zcam) {
 
     this->config = config;
     this->server = this->config["server"].get<string>();
     this->host = config["host"].get<string>();
     this->serviceName = serviceName;
 
-    snapshotService = new ZCAMSnapshot(config);
+    snapshotService = new ZCAMSnapshot(config, zcam);
+
+    configure();
 
     std::cout << "service ready" << std::endl;
 }
 
+// One poller for every camera of the site, sources[i] may be null when not streaming
+someService::someService(json config, string serviceName, const vector<ZCAM*>& sources) {
+
+    this->config = config;
+    this->server = this->config["server"].get<string>();
+    this->host = config["host"].get<string>();
+    this->serviceName = serviceName;
+
+    for (size_t i = 0; i < config["cameras"].size(); i++) {
+        json camConfig = config;
+        camConfig["cam_id"] = to_string(i);
+        ZCAM *source = i < sources.size() ? sources[i] : nullptr;
+        cameraSnapshots[config["cameras"][i].get<string>()] = new ZCAMSnapshot(camConfig, source);
+    }
+
+    snapshotService = cameraSnapshots.empty() ? nullptr : cameraSnapshots.begin()->second;
+
+    configure();
+
+    std::cout << "service ready for " << cameraSnapshots.size() << " cameras" << std::endl;
+}
+
+// "service_threads" workers run the handlers; "service_push" (default off) probes "service_push_url" for an SSE stream
+void someService::configure() {
+
+    int threads = config.count("service_threads") > 0 ? config["service_threads"].get<int>() :
+        max(2, static_cast<int>(cameraSnapshots.size()));
+    workers = new someThreadPool(threads);
+
+    if (config.count("service_push") > 0)
+        push = config["service_push"].get<bool>();
+    if (config.count("service_push_url") > 0)
+        push_url = config["service_push_url"].get<string>();
+    if (config.count("service_min_poll_ms") > 0)
+        min_poll = chrono::milliseconds(config["service_min_poll_ms"].get<int>());
+
+    handle("snapshot", [this](const json& params) { return snapshot(params); });
+    handle("burst", [this](const json& params) {
+        return eachCamera(params, [&params](ZCAMSnapshot *snap) { return snap->burst(params); });
+    });
+    handle("timelapse", [this](const json& params) {
+        return eachCamera(params, [&params](ZCAMSnapshot *snap) { return snap->timelapse(params); });
+    });
+    handle("snapshots", [this](const json& params) {
+        return eachCamera(params, [&params](ZCAMSnapshot *snap) { return snap->history(params); });
+    });
+    handle("snapshot_fetch", [this](const json& params) {
+        return eachCamera(params, [&params](ZCAMSnapshot *snap) { return snap->fetch(params); });
+    });
+    handle("timelapse_stop", [this](const json& params) {
+        return eachCamera(params, [](ZCAMSnapshot *snap) { snap->stopTimelapse(); return json("stopped"); });
+    });
+}
+
+void someService::handle(const string& api, Handler handler) {
+    handlers[api] = handler;
+}
+
+// params["camera"] by name or index, empty when it names no camera of this site
+string someService::cameraName(const json& params) {
+
+    string camera;
+    if (params.contains("camera")) {
+        if (params["camera"].is_number()) {
+            size_t idx = params["camera"].get<size_t>();
+            if (idx < config["cameras"].size()) camera = config["cameras"][idx].get<string>();
+        }
+        else camera = params["camera"].get<string>();
+    }
+    return cameraSnapshots.count(camera) > 0 ? camera : "";
+}
+
+// Runs action on the camera params names, or on every camera concurrently with results keyed by name
+json someService::eachCamera(const json& params, function<json(ZCAMSnapshot*)> action) {
+
+    if (cameraSnapshots.empty()) return action(snapshotService);
+
+    string camera = cameraName(params);
+    if (!camera.empty()) return action(cameraSnapshots[camera]);
+
+    map<string, future<json>> running;
+    for (auto& [name, snap] : cameraSnapshots)
+        running[name] = async(launch::async, action, snap);
+
+    auto result = nlohmann::json::object();
+    for (auto& [name, done] : running) result[name] = done.get();
+    return result;
+}
+
+// params["camera"] picks one camera by name or index, otherwise every camera is taken
+json someService::snapshot(const json& params) {
+
+    auto result = nlohmann::json();
+
+    if (cameraSnapshots.empty()) {
+        result["path"] = snapshotService->take();
+        result["renditions"] = snapshotService->lastPaths();
+        return result;
+    }
+
+    string camera = cameraName(params);
+
+    if (!camera.empty() && cameraSnapshots.count(camera) > 0) {
+        result["path"] = cameraSnapshots[camera]->take();
+        result["renditions"] = cameraSnapshots[camera]->lastPaths();
+        return result;
+    }
+
+    result["paths"] = nlohmann::json::object();
+    for (auto& [name, snap] : cameraSnapshots) {
+        auto path = snap->take();
+        result["paths"][name] = path;
+        if (!result.contains("path")) result["path"] = path;
+    }
+
+    return result;
+}
+
 bool isUrl(const string& file) {
     return file.substr(0, 7) == "http://" || file.substr(0, 8) == "https://";
 }
@@ -93,160 +217,104 @@ void someService::post_status(string status) {
     net.https_request(server, "/apis/requests/status", http::verb::post, params);
 }
 
-void someService::run() {
+// Hands the request to the worker pool and returns right away, so the next poll is already out
+// while a slow snapshot is still being taken
+void someService::dispatch(const json& request) {
 
-    someNetwork net;
+    if (!request.contains("api")) return;
 
-    post_status("init");
+    string api = request["api"].get<string>();
+    if (api == "keepalive") return;
 
-    someLogger::getInstance()->log("START SERVICE");
+    someLogger::getInstance()->log("NEW REQUEST# " + request.dump(4));
 
-    while (true) {
+    if (api == "shutdown") {
+        stopping = true;
+        return;
+    }
 
-        try {
+    auto it = handlers.find(api);
+    if (it == handlers.end()) {
+        auto error = nlohmann::json();
+        error["error"] = "unknown api " + api;
+        post_response(request, "error", error);
+        return;
+    }
 
-            auto response = net.https_get(server, "/apis/requests?service=" + serviceName + "&host=" + host);
+    auto params = request.contains("params") ? request["params"] : nlohmann::json();
+    Handler handler = it->second;
 
-            if (response.timeout) continue;
+    workers->post([this, request, params, handler]() {
+        try {
+            post_response(request, "ok", handler(params));
+        }
+        catch (const std::exception& e) {
+            auto error = nlohmann::json();
+            error["error"] = e.what();
+            post_response(request, "error", error);
+        }
+    });
+}
 
-            auto json = response.json;
+void someService::run() {
 
-            someLogger::getInstance()->log("NEW REQUEST# " + json.dump(4)); 
+    someNetwork net;
 
-            string api;
+    post_status("init");
 
-            if (response.status == 200 && json.contains("api")) {
-                api = json["api"].get<string>();
-                if (api == "keepalive") continue;
-            }
+    someLogger::getInstance()->log("START SERVICE");
+
+    string query = "?service=" + serviceName + "&host=" + host;
+    auto next_probe = chrono::steady_clock::now();
+    int backoff = 1;
 
-            string request_id;
+    while (!stopping) {
 
-            auto params = nlohmann::json();
+        try {
 
-            if (response.status == 200 && !response.str.empty()) {
-                if (json.contains("id")) request_id = json["id"].get<string>();
-                if (json.contains("params")) params = json["params"];
+            // Push channel first; a server without it is re-probed every PUSH_RETRY while we long-poll
+            if (push && chrono::steady_clock::now() >= next_probe) {
+                bool delivered = false;
+                bool supported = net.https_events(server, push_url + query, [&](const string& data) {
+                    delivered = true;
+                    try {
+                        dispatch(nlohmann::json::parse(data));
+                    }
+                    catch (const nlohmann::json::exception& e) {
+                        someLogger::getInstance()->log("bad event# " + data);
+                    }
+                    return !stopping;
+                });
+                if (!supported) {
+                    someLogger::getInstance()->log("push channel unavailable, long-polling");
+                    next_probe = chrono::steady_clock::now() + PUSH_RETRY;
+                } else if (!stopping) {
+                    // Dropped stream: reconnect at once after a healthy session, back off when it keeps failing
+                    backoff = delivered ? 1 : min(backoff * 2, MAX_BACKOFF);
+                    this_thread::sleep_for(chrono::seconds(backoff));
+                }
+                continue;
             }
 
-            // TODO: generic STUB with callbacks 
+            auto start = chrono::steady_clock::now();
+            auto response = net.https_get(server, "/apis/requests" + query);
 
-            if (api == "snapshot") {
-                string path = snapshotService->take();
-                auto result = nlohmann::json();
-                result["path"] = path; 
-                post_response(json, "ok", result);
-            }
+            if (response.timeout) continue;
 
-            // auto job = response.json["job"];
-            // size_t job_id = job["jobId"];
-            // string task = job["task"];
-
-            // auto jparams = job["params"];
-            // string access_token = jparams.contains("access_token") ? jparams["access_token"] : "";
-
-            // auto params = nlohmann::json();
-            // params["jobId"] = job_id;
-            // params["host"] = host;
-            // params["data"] = nlohmann::json();
-
-            // if (task == "file") {
-            //     string event_id = jparams["eventId"];
-            //     string file_name = jparams["fileName"];
-            //     string path = string("downloads/").append(event_id).append("/swfiles/").append(file_name);
-            //     auto size = uploader.tcpUpload(path, job_id);
-//                if (size == 0)
-//                    params["status"] = "error";
-//                else {
-//                    params["data"]["size"] = size;
-//                    params["status"] = "done";
-//                }
-//                network.https_request(server, "/updateJob", http::verb::put, params);
-
-            // else if (task == "download") {
-            //     string event_id = jparams["eventId"];
-            //     vector<string> files = jparams["fileIds"];
-            //     string fileName = jparams.contains("fileName") ? jparams["fileName"].get<string>() : to_string(job_id);
-            //     string driveId = storage.uploadFiles(event_id, fileName, files, access_token);
-            //     storage.setFilePermissions(driveId, access_token);
-//                auto jfile = storage.getFile(driveId, access_token);
-//                cout << "getFile response# "  << jfile.dump() << endl;
-//                https://drive.google.com/uc?id=1ZRRukmSHNF6lWuL4G1-fycJyYQsXXvzb&export=download
-//                params["data"]["downloadLink"] = jfile["webContentLink"];
-            //     params["data"]["downloadLink"] = "https://drive.google.com/uc?id=" + driveId + "&export=download";
-            //     params["status"] = "ready";
-            //     network.https_request(server, "/updateJob", http::verb::put, params);
-            // }
-
-            // else if (task == "scan") {
-            //     params["data"]["files"] = nlohmann::json();
-            //     params["data"]["filesIds"] = nlohmann::json();
-            //     params["data"]["filesInfo"] = nlohmann::json();
-            //     string event_id = jparams["eventId"];
-            //     string folder_id = jparams["folderId"];
-            //     auto st = storage.downloadFiles(event_id + "/files", folder_id, params, access_token);
-            //     if (st) {
-            //         storage.reportProgress(params);
-            //         scan(event_id + "/files", params, true);
-            //         params["status"] = "done";
-            //     }
-            //     else
-            //         params["status"] = "error";
-            //     params["processTime"] = Logger::timeSinceEpochMilli() - start_time;
-            //     network.https_request(server, "/updateJob", http::verb::put, params);
-            //     if (st)
-            //         Database::getInstance()->log();
-            // }
-
-            // else if (task == "search" && job["params"].contains("folderId")) {
-            //     params["data"]["files"] = nlohmann::json();
-            //     params["data"]["filesIds"] = nlohmann::json();
-            //     params["data"]["filesInfo"] = nlohmann::json();
-            //     string event_id = jparams["eventId"];
-            //     string folder_id = jparams["folderId"];
-            //     auto ok = storage.downloadFiles(event_id + "/selfies", folder_id, params, access_token);
-            //     if (!ok) params["status"] = "error";
-            //     if (ok) {
-            //         Logger::getInstance()->log("downloadFiles ok!");
-            //         auto dbValues = scan(event_id + "/selfies", params, true);
-            //         Logger::getInstance()->log("post scan files# " + params["data"]["files"].dump());
-            //         auto skip = string(event_id + "/selfies/").size();
-            //         printf("scanned %ld faces", dbValues.size());
-            //         for (int i = 0; i < dbValues.size(); i++) {
-            //             auto dbValue = dbValues[i];
-            //             auto path = dbValue.dbPath;
-            //             string id = dbValue.fileId; // path.substr(skip);
-            //             Logger::getInstance()->log("post fileId# " + id);
-            //             params["data"]["filesIds"][id] = true;
-            //             if (!params["data"]["files"][id].contains("faces"))
-            //                 params["data"]["files"][id]["faces"] = vector<nlohmann::json>();
-            //             nlohmann::json jface;
-            //             // todo: add face attributes
-            //             jface["neighbors"] = vector<nlohmann::json>();
-            //             auto faces = search(dbValue);
-            //             for (DBValue face: faces) {
-            //                 nlohmann::json n;
-            //                 n["fileId"] = face.fileId;
-            //                 n["index"] = face.faceIndex;
-            //                 n["similarity"] = face.similarity;
-            //                 jface["neighbors"].push_back(n);
-            //                 if (!face.fileId.empty() && face.fileId != "selfie")
-            //                     params["data"]["filesIds"][face.fileId] = true;
-            //             }
-            //             params["data"]["files"][id]["faces"].push_back(jface);
-            //         }
-            //         Logger::getInstance()->log("post search files# " + params["data"]["files"].dump());
-            //         params["status"] = "done";
-            //         Database::getInstance()->log();
-            //     }
-            //     network.https_request(server, "/updateJob", http::verb::put, params);
-            // }
-
-            else if (api == "shutdown") break;
-
-            else { 
-                this_thread::sleep_for(std::chrono::milliseconds(10000));
+            if (response.status != 200) {
+                this_thread::sleep_for(chrono::seconds(backoff));
+                backoff = min(backoff * 2, MAX_BACKOFF);
+                continue;
             }
+            backoff = 1;
+
+            bool request = !response.str.empty() && response.json.contains("api") &&
+                           response.json["api"].get<string>() != "keepalive";
+            if (request) dispatch(response.json);
+
+            // A server that answers an empty poll at once instead of holding it is paced, not hammered
+            auto elapsed = chrono::steady_clock::now() - start;
+            if (!request && elapsed < min_poll) this_thread::sleep_for(min_poll - elapsed);
 
         }
         catch (const std::exception& e) {
@@ -254,4 +322,8 @@ void someService::run() {
         }
 
     }
+
+    // Let requests already handed out finish and answer
+    delete workers;
+    workers = nullptr;
 }
@@ -0,0 +1,45 @@
+#include <someThreadPool.h>
+#include <iostream>
+
+someThreadPool::someThreadPool(int threads) {
+    if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(&someThreadPool::work, this);
+}
+
+someThreadPool::~someThreadPool() {
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for (auto& worker : workers)
+        if (worker.joinable()) worker.join();
+}
+
+void someThreadPool::post(function<void()> task) {
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        tasks.push(std::move(task));
+    }
+    queue_cv.notify_one();
+}
+
+void someThreadPool::work() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        try {
+            task();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "pool task error: " << e.what() << std::endl;
+        }
+    }
+}
@@ -0,0 +1,224 @@
+#include <someUploader.h>
+#include <someNetwork.h>
+#include <someLogger.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = filesystem;
+
+someUploader *someUploader::_instance;
+
+someUploader *someUploader::getInstance(const json& config) {
+    if (_instance == nullptr)
+        _instance = new someUploader(config);
+    return _instance;
+}
+
+someUploader *someUploader::getInstance() {
+    return _instance;
+}
+
+someUploader::someUploader(const json& config) {
+
+    server = config["server"].get<string>();
+    spool_dir = config["files"].get<string>() + "spool/";
+
+    if (config.count("upload") > 0) {
+        auto jupload = config["upload"];
+        capacity = max(1, jupload.value("queue", 64));
+        batch_size = max(1, jupload.value("batch", 1));
+        max_backoff = max(1, jupload.value("max_backoff", 300));
+        if (jupload.count("spool") > 0)
+            spool_dir = jupload["spool"].get<string>();
+        if (jupload.count("spool_mb") > 0)
+            max_spool = static_cast<uintmax_t>(jupload["spool_mb"].get<int>()) << 20;
+    }
+
+    error_code ec;
+    fs::create_directories(spool_dir, ec);
+
+    worker = thread(&someUploader::drain, this);
+}
+
+void someUploader::post(const string& url, const json& record, const string& mirror) {
+
+    Item overflow;
+    bool spilled = false;
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        if (closed) return;
+        if (queue.size() >= capacity) {
+            overflow = std::move(queue.front());
+            queue.pop_front();
+            spilled = true;
+        }
+        queue.push_back({url, record, mirror});
+    }
+    queue_cv.notify_one();
+
+    if (spilled) spill(overflow.url, {overflow.record});
+}
+
+void someUploader::close() {
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        closed = true;
+    }
+    queue_cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void someUploader::drain() {
+
+    int backoff = 1;
+
+    while (true) {
+
+        vector<Item> items;
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return closed || !queue.empty(); });
+            if (closed) break;
+            string url = queue.front().url;
+            while (!queue.empty() && queue.front().url == url && items.size() < batch_size) {
+                items.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        const string& url = items.front().url;
+        vector<json> records;
+        for (auto& item : items) {
+            if (!item.mirror.empty()) writeMirror(item);
+            records.push_back(item.record);
+        }
+
+        // Older spilled records go out first so the server sees them in order
+        bool sent;
+        if (fs::exists(spoolPath(url))) {
+            spill(url, records);
+            sent = replay(url);
+        } else {
+            sent = send(url, records);
+            if (!sent) spill(url, records);
+        }
+
+        if (sent) {
+            backoff = 1;
+            continue;
+        }
+
+        cout << "📤 upload " << url << " failed, retry in " << backoff << "s" << endl;
+        unique_lock<mutex> lock(queue_mutex);
+        queue_cv.wait_for(lock, chrono::seconds(backoff), [this]() { return closed; });
+        backoff = min(backoff * 2, max_backoff);
+    }
+
+    // Shutting down - keep the records for the next run rather than waiting on the network
+    lock_guard<mutex> lock(queue_mutex);
+    while (!queue.empty()) {
+        auto item = std::move(queue.front());
+        queue.pop_front();
+        if (!item.mirror.empty()) writeMirror(item);
+        spill(item.url, {item.record});
+    }
+}
+
+bool someUploader::send(const string& url, const vector<json>& records) {
+
+    json body = records.size() == 1 ? records.front() : json(records);
+
+    someNetwork net;
+    auto response = net.https_request(server, url, http::verb::post, body);
+
+    // 4xx means the server will never take this record, dropping it beats retrying forever
+    if (response.status >= 400 && response.status < 500) {
+        someLogger::getInstance()->error("upload# " + url + " rejected " + to_string(response.status));
+        return true;
+    }
+
+    return response.status >= 200 && response.status < 300;
+}
+
+string someUploader::spoolPath(const string& url) {
+    string name = url;
+    for (auto& c : name)
+        if (c == '/') c = '_';
+    return spool_dir + name + ".jsonl";
+}
+
+void someUploader::spill(const string& url, const vector<json>& records) {
+
+    string path = spoolPath(url);
+    lock_guard<mutex> lock(spool_mutex);
+
+    error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (!ec && size > max_spool) {
+        someLogger::getInstance()->error("upload# spool " + path + " full, dropping " + to_string(records.size()) + " records");
+        return;
+    }
+
+    ofstream spool(path, ios::app);
+    for (auto& record : records)
+        spool << record.dump() << "\n";
+}
+
+vector<json> someUploader::readSpool(const string& path) {
+    vector<json> records;
+    ifstream spool(path);
+    string line;
+    while (getline(spool, line)) {
+        if (line.empty()) continue;
+        try {
+            records.push_back(json::parse(line));
+        } catch(exception const&e) {
+
+        }
+    }
+    return records;
+}
+
+bool someUploader::replay(const string& url) {
+
+    string path = spoolPath(url);
+
+    vector<json> pending;
+    {
+        lock_guard<mutex> lock(spool_mutex);
+        pending = readSpool(path);
+        error_code ec;
+        fs::remove(path, ec);
+    }
+
+    size_t done = 0;
+    while (done < pending.size()) {
+        size_t n = min(batch_size, pending.size() - done);
+        if (!send(url, vector<json>(pending.begin() + done, pending.begin() + done + n))) break;
+        done += n;
+    }
+
+    if (done == pending.size()) return true;
+
+    // Put the unsent records back ahead of anything spilled while we were sending
+    lock_guard<mutex> lock(spool_mutex);
+    auto newer = readSpool(path);
+    ofstream spool(path, ios::trunc);
+    for (size_t i = done; i < pending.size(); i++)
+        spool << pending[i].dump() << "\n";
+    for (auto& record : newer)
+        spool << record.dump() << "\n";
+
+    return false;
+}
+
+void someUploader::writeMirror(const Item& item) {
+    ofstream statusLog(item.mirror);
+    if (statusLog.is_open()) {
+        statusLog << item.record.dump(4); // The 4 creates an indentation of 4 spaces
+        statusLog.close();
+    }
+}
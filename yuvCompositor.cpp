@@ -0,0 +1,332 @@
+#include <yuvCompositor.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+struct Layout {
+    int shift_x = 0;     // log2 chroma subsampling
+    int shift_y = 0;
+    bool chroma = true;
+    bool interleaved = false;   // NV12
+};
+
+bool layoutOf(int format, Layout& layout) {
+    switch (static_cast<AVPixelFormat>(format)) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            layout.shift_x = layout.shift_y = 1;
+            return true;
+        case AV_PIX_FMT_NV12:
+            layout.shift_x = layout.shift_y = 1;
+            layout.interleaved = true;
+            return true;
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUVJ422P:
+            layout.shift_x = 1;
+            return true;
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUVJ444P:
+            return true;
+        case AV_PIX_FMT_GRAY8:
+            layout.chroma = false;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Address of chroma sample (cx, cy); plane 1 = U, 2 = V
+inline uint8_t* chromaAt(AVFrame* frame, const Layout& layout, int plane, int cx, int cy) {
+    if (layout.interleaved)
+        return frame->data[1] + static_cast<ptrdiff_t>(cy) * frame->linesize[1] + 2 * cx + (plane - 1);
+    return frame->data[plane] + static_cast<ptrdiff_t>(cy) * frame->linesize[plane] + cx;
+}
+
+inline uint8_t mix(uint8_t dst, uint8_t src, int alpha) {
+    return static_cast<uint8_t>(dst + ((src - dst) * alpha + 127) / 255);
+}
+
+// BT.601, the matrix the camera streams and the MJPEG encoder use
+void rgbToYUV(int r, int g, int b, bool full_range, uint8_t& y, uint8_t& u, uint8_t& v) {
+    double fy, fu, fv;
+    if (full_range) {
+        fy = 0.299 * r + 0.587 * g + 0.114 * b;
+        fu = 128 - 0.168736 * r - 0.331264 * g + 0.5 * b;
+        fv = 128 + 0.5 * r - 0.418688 * g - 0.081312 * b;
+    } else {
+        fy = 16 + (65.481 * r + 128.553 * g + 24.966 * b) / 255;
+        fu = 128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255;
+        fv = 128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255;
+    }
+    y = static_cast<uint8_t>(min(255.0, max(0.0, fy + 0.5)));
+    u = static_cast<uint8_t>(min(255.0, max(0.0, fu + 0.5)));
+    v = static_cast<uint8_t>(min(255.0, max(0.0, fv + 0.5)));
+}
+
+}
+
+bool YUVCompositor::isSupported(int format) {
+    Layout layout;
+    return layoutOf(format, layout);
+}
+
+bool YUVCompositor::isFullRange(const AVFrame* frame) {
+    return frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P ||
+           frame->format == AV_PIX_FMT_YUVJ422P || frame->format == AV_PIX_FMT_YUVJ444P ||
+           frame->format == AV_PIX_FMT_GRAY8;
+}
+
+YUVColor YUVCompositor::color(const string& name, bool full_range) {
+
+    int r = 255, g = 255, b = 255;
+    string value = name.substr(0, name.find('@'));   // drawtext/drawbox "color@alpha"
+
+    if (value == "red") { r = 255; g = 0; b = 0; }
+    else if (value == "yellow") { r = 255; g = 255; b = 0; }
+    else if (value == "green") { r = 0; g = 128; b = 0; }
+    else if (value == "blue") { r = 0; g = 0; b = 255; }
+    else if (value == "black") { r = 0; g = 0; b = 0; }
+    else if (value.rfind("0x", 0) == 0 || value.rfind("#", 0) == 0) {
+        try {
+            long rgb = stol(value.substr(value[0] == '#' ? 1 : 2), nullptr, 16);
+            r = (rgb >> 16) & 0xFF;
+            g = (rgb >> 8) & 0xFF;
+            b = rgb & 0xFF;
+        } catch(exception const&e) {
+
+        }
+    }
+
+    YUVColor color;
+    rgbToYUV(r, g, b, full_range, color.y, color.u, color.v);
+    return color;
+}
+
+// Hershey glyphs from OpenCV, scaled so the line height roughly matches a drawtext fontsize
+YUVCompositor::Font& YUVCompositor::font(int size) {
+
+    auto it = fonts.find(size);
+    if (it != fonts.end()) return it->second;
+
+    Font& font = fonts[size];
+    double scale = size / 32.0;
+    int thickness = max(1, size / 20);
+    int pad = thickness + 1;
+
+    int ascent = 0, descent = 0, total = 0;
+    for (int c = 32; c < 127; c++) {
+        int baseline = 0;
+        cv::Size sz = cv::getTextSize(string(1, static_cast<char>(c)), cv::FONT_HERSHEY_SIMPLEX, scale, thickness, &baseline);
+        font.width[c - 32] = sz.width + 2 * pad;
+        font.x[c - 32] = total;
+        total += font.width[c - 32];
+        ascent = max(ascent, sz.height);
+        descent = max(descent, baseline);
+    }
+
+    font.height = ascent + descent + 2 * pad;
+    font.atlas = cv::Mat::zeros(font.height, total, CV_8UC1);
+    for (int c = 32; c < 127; c++)
+        cv::putText(font.atlas, string(1, static_cast<char>(c)), cv::Point(font.x[c - 32] + pad, pad + ascent),
+                    cv::FONT_HERSHEY_SIMPLEX, scale, cv::Scalar(255), thickness, cv::LINE_AA);
+
+    return font;
+}
+
+int YUVCompositor::textWidth(const string& text, int size) {
+    Font& f = font(size);
+    int width = 0;
+    for (char c : text)
+        if (c >= 32 && c < 127) width += f.width[c - 32];
+    return width;
+}
+
+int YUVCompositor::textHeight(int size) {
+    return font(size).height;
+}
+
+void YUVCompositor::fill(AVFrame* frame, int x, int y, int w, int h, const YUVColor& color) {
+
+    int x0 = max(0, x), y0 = max(0, y);
+    int x1 = min(frame->width, x + w), y1 = min(frame->height, y + h);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int row = y0; row < y1; row++)
+        memset(frame->data[0] + static_cast<ptrdiff_t>(row) * frame->linesize[0] + x0, color.y, x1 - x0);
+
+    Layout layout;
+    layoutOf(frame->format, layout);
+    if (!layout.chroma) return;
+
+    int cx0 = x0 >> layout.shift_x, cx1 = (x1 + (1 << layout.shift_x) - 1) >> layout.shift_x;
+    int cy0 = y0 >> layout.shift_y, cy1 = (y1 + (1 << layout.shift_y) - 1) >> layout.shift_y;
+    for (int cy = cy0; cy < cy1; cy++) {
+        if (layout.interleaved) {
+            uint8_t* uv = chromaAt(frame, layout, 1, cx0, cy);
+            for (int cx = cx0; cx < cx1; cx++, uv += 2) {
+                uv[0] = color.u;
+                uv[1] = color.v;
+            }
+        } else {
+            memset(chromaAt(frame, layout, 1, cx0, cy), color.u, cx1 - cx0);
+            memset(chromaAt(frame, layout, 2, cx0, cy), color.v, cx1 - cx0);
+        }
+    }
+}
+
+// Alpha-blends a solid color through an 8-bit coverage mask; chroma takes the mean coverage of its block
+void YUVCompositor::blend(AVFrame* frame, int x, int y, const uint8_t* mask, int stride, int w, int h, const YUVColor& color) {
+
+    int x0 = max(0, x), y0 = max(0, y);
+    int x1 = min(frame->width, x + w), y1 = min(frame->height, y + h);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int row = y0; row < y1; row++) {
+        uint8_t* dst = frame->data[0] + static_cast<ptrdiff_t>(row) * frame->linesize[0];
+        const uint8_t* m = mask + static_cast<ptrdiff_t>(row - y) * stride - x;
+        for (int col = x0; col < x1; col++)
+            if (m[col]) dst[col] = mix(dst[col], color.y, m[col]);
+    }
+
+    Layout layout;
+    layoutOf(frame->format, layout);
+    if (!layout.chroma) return;
+
+    int bw = 1 << layout.shift_x, bh = 1 << layout.shift_y;
+    for (int cy = y0 >> layout.shift_y; cy < (y1 + bh - 1) >> layout.shift_y; cy++)
+        for (int cx = x0 >> layout.shift_x; cx < (x1 + bw - 1) >> layout.shift_x; cx++) {
+            int sum = 0;
+            for (int by = cy * bh; by < cy * bh + bh; by++)
+                for (int bx = cx * bw; bx < cx * bw + bw; bx++)
+                    if (by >= y0 && by < y1 && bx >= x0 && bx < x1) sum += mask[(by - y) * stride + (bx - x)];
+            int alpha = sum / (bw * bh);
+            if (!alpha) continue;
+            uint8_t* u = chromaAt(frame, layout, 1, cx, cy);
+            uint8_t* v = chromaAt(frame, layout, 2, cx, cy);
+            *u = mix(*u, color.u, alpha);
+            *v = mix(*v, color.v, alpha);
+        }
+}
+
+// Border of `thickness` pixels inside the rectangle, like drawbox
+bool YUVCompositor::drawRect(AVFrame* frame, int x, int y, int w, int h, const YUVColor& color, int thickness) {
+    if (!isSupported(frame->format) || w <= 0 || h <= 0) return false;
+    int t = max(1, min(thickness, min(w, h) / 2 + 1));
+    fill(frame, x, y, w, t, color);
+    fill(frame, x, y + h - t, w, t, color);
+    fill(frame, x, y + t, t, h - 2 * t, color);
+    fill(frame, x + w - t, y + t, t, h - 2 * t, color);
+    return true;
+}
+
+bool YUVCompositor::drawText(AVFrame* frame, int x, int y, const string& text, const YUVColor& color, int size) {
+
+    if (!isSupported(frame->format)) return false;
+
+    Font& f = font(size);
+    int stride = static_cast<int>(f.atlas.step);
+
+    for (char c : text) {
+        if (c < 32 || c >= 127) continue;
+        int g = c - 32;
+        if (c != ' ')
+            blend(frame, x, y, f.atlas.data + f.x[g], stride, f.width[g], f.height, color);
+        x += f.width[g];
+        if (x >= frame->width) break;
+    }
+    return true;
+}
+
+bool YUVCompositor::convertLogo(const AVFrame* rgba, int format, bool full_range) {
+
+    Layout layout;
+    if (!layoutOf(format, layout) || rgba->format != AV_PIX_FMT_RGBA) return false;
+
+    logoWidth = rgba->width;
+    logoHeight = rgba->height;
+    logoY.assign(logoWidth * logoHeight, 0);
+    logoA.assign(logoWidth * logoHeight, 0);
+
+    int cw = (logoWidth + (1 << layout.shift_x) - 1) >> layout.shift_x;
+    int ch = (logoHeight + (1 << layout.shift_y) - 1) >> layout.shift_y;
+    vector<int> su(cw * ch, 0), sv(cw * ch, 0), sa(cw * ch, 0), n(cw * ch, 0);
+
+    for (int row = 0; row < logoHeight; row++) {
+        const uint8_t* p = rgba->data[0] + static_cast<ptrdiff_t>(row) * rgba->linesize[0];
+        for (int col = 0; col < logoWidth; col++, p += 4) {
+            uint8_t y, u, v;
+            rgbToYUV(p[0], p[1], p[2], full_range, y, u, v);
+            int a = p[3];
+            int i = row * logoWidth + col;
+            logoY[i] = static_cast<uint8_t>((y * a + 127) / 255);
+            logoA[i] = static_cast<uint8_t>(a);
+            int c = (row >> layout.shift_y) * cw + (col >> layout.shift_x);
+            su[c] += u * a;
+            sv[c] += v * a;
+            sa[c] += a;
+            n[c]++;
+        }
+    }
+
+    logoU.assign(cw * ch, 0);
+    logoV.assign(cw * ch, 0);
+    logoCA.assign(cw * ch, 0);
+    for (int c = 0; c < cw * ch; c++) {
+        if (!n[c]) continue;
+        logoU[c] = static_cast<uint8_t>(su[c] / (255 * n[c]));
+        logoV[c] = static_cast<uint8_t>(sv[c] / (255 * n[c]));
+        logoCA[c] = static_cast<uint8_t>(sa[c] / n[c]);
+    }
+
+    logoSource = rgba;
+    logoFormat = format;
+    logoFullRange = full_range;
+    return true;
+}
+
+// out = logo_premultiplied + dst * (1 - alpha); the logo is converted only when it or the frame layout changes
+bool YUVCompositor::drawLogo(AVFrame* frame, const AVFrame* rgba, int x, int y) {
+
+    bool full_range = isFullRange(frame);
+    if (rgba != logoSource || frame->format != logoFormat || full_range != logoFullRange)
+        if (!convertLogo(rgba, frame->format, full_range)) return false;
+
+    Layout layout;
+    layoutOf(frame->format, layout);
+
+    int x0 = max(0, x), y0 = max(0, y);
+    int x1 = min(frame->width, x + logoWidth), y1 = min(frame->height, y + logoHeight);
+    if (x0 >= x1 || y0 >= y1) return true;
+
+    for (int row = y0; row < y1; row++) {
+        uint8_t* dst = frame->data[0] + static_cast<ptrdiff_t>(row) * frame->linesize[0];
+        int i = (row - y) * logoWidth - x;
+        for (int col = x0; col < x1; col++) {
+            int a = logoA[i + col];
+            if (a) dst[col] = static_cast<uint8_t>(logoY[i + col] + (dst[col] * (255 - a) + 127) / 255);
+        }
+    }
+
+    if (!layout.chroma) return true;
+
+    // Chroma is blended on whole blocks, so the logo should sit on even coordinates for 4:2:0
+    int cw = (logoWidth + (1 << layout.shift_x) - 1) >> layout.shift_x;
+    int ch = (logoHeight + (1 << layout.shift_y) - 1) >> layout.shift_y;
+    int lx = x >> layout.shift_x, ly = y >> layout.shift_y;
+    int cx1 = (x1 + (1 << layout.shift_x) - 1) >> layout.shift_x;
+    int cy1 = (y1 + (1 << layout.shift_y) - 1) >> layout.shift_y;
+    for (int cy = y0 >> layout.shift_y; cy < cy1; cy++)
+        for (int cx = x0 >> layout.shift_x; cx < cx1; cx++) {
+            if (cx - lx >= cw || cy - ly >= ch) continue;
+            int c = (cy - ly) * cw + (cx - lx);
+            int a = logoCA[c];
+            if (!a) continue;
+            uint8_t* u = chromaAt(frame, layout, 1, cx, cy);
+            uint8_t* v = chromaAt(frame, layout, 2, cx, cy);
+            *u = static_cast<uint8_t>(logoU[c] + (*u * (255 - a) + 127) / 255);
+            *v = static_cast<uint8_t>(logoV[c] + (*v * (255 - a) + 127) / 255);
+        }
+
+    return true;
+}
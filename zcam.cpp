@@ -1,9 +1,15 @@
 #include <zcam.h>
 #include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
 #include <chrono>
 #include <someFFMpeg.h>
+#include <someLogger.h>
+#include <someMetrics.h>
    
-    ZCAM::ZCAM(const json& config, const int cam_idx) {
+    ZCAM::ZCAM(const json& config, const int cam_idx)
+        : frames(config.count("ring_size") > 0 ? config["ring_size"].get<int>() : 3) {
 
         root = config["files"].get<string>();
         camera_ip = config["ipaddr"][cam_idx].get<string>();
@@ -11,6 +17,40 @@
         rtsp_url = "rtsp://" + camera_ip + "/live_stream";
         http_base_url = "http://" + camera_ip + "/ctrl";
 
+        // Any FFmpeg URL per camera instead of the camera's RTSP stream, e.g. a recorded Annex B clip for replay
+        if (config.count("stream_url") > 0)
+            rtsp_url = config["stream_url"][cam_idx].get<string>();
+
+        if (config.count("max_backoff") > 0)
+            max_backoff = config["max_backoff"].get<int>();
+
+        if (config.count("sampling") > 0) {
+            auto mode = config["sampling"].get<string>();
+            if (mode == "keyframe") sampling = SAMPLE_KEYFRAME;
+            else if (mode == "fast") sampling = SAMPLE_KEYFRAME_FAST;
+        }
+
+        // Keyframe sampling discards everything up to the next IDR, so it needs about a GOP more
+        if (sampling != SAMPLE_ALL) max_packets = 300;
+        if (config.count("max_packets") > 0)
+            max_packets = max(1, config["max_packets"].get<int>());
+
+        decoder = someFFMpeg::decoderOptions(config, cam_idx);
+
+        if (config.count("stream_cache") > 0)
+            stream_cache = config["stream_cache"].get<bool>();
+        layout_path = root + "state/stream_" + camera_id + ".json";
+        if (stream_cache) loadLayout();
+
+        if (config.count("hwaccel") > 0) {
+            auto name = config["hwaccel"].get<string>();
+            hw_type = av_hwdevice_find_type_by_name(name.c_str());
+            if (hw_type == AV_HWDEVICE_TYPE_NONE)
+                someLogger::getInstance()->log(camera_id + " unknown hwaccel " + name + ", decoding in software");
+            if (config.count("hwaccel_device") > 0)
+                hw_device = config["hwaccel_device"].get<string>();
+        }
+
         // Initialize FFmpeg
         #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
         av_register_all();
@@ -20,12 +60,255 @@
     } 
 
     ZCAM::~ZCAM() {
+        stopStream();
         cleanup();
+        if (hw_device_ctx) av_buffer_unref(&hw_device_ctx);
+        if (sw_frame) av_frame_free(&sw_frame);
+        if (download_pool) av_buffer_pool_uninit(&download_pool);
+        if (capture_packet) av_packet_free(&capture_packet);
         avformat_network_deinit();        
     }
     
+    bool ZCAM::hasStartCode(const uint8_t *data, int size) {
+        return size >= 4 &&
+            ((data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x00 && data[3] == 0x01) ||
+             (data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x01));
+    }
+
+    // What a NAL unit header means for sampling and the stream cache. H.264 keeps the type in the low
+    // 5 bits (SPS 7, PPS 8, IDR 5); HEVC in bits 1-6 (VPS 32, SPS 33, PPS 34, IRAP 16-23). Other codecs
+    // are not parsed: their packets count as key only when the demuxer flags them.
+    ZCAM::NalKind ZCAM::nalKind(AVCodecID codec_id, uint8_t header, int& type) {
+        type = -1;
+        if (codec_id == AV_CODEC_ID_H264) {
+            type = header & 0x1F;
+            if (type == 7 || type == 8) return NAL_PARAMETER_SET;
+            if (type == 5) return NAL_KEY_SLICE;
+            if (type == 1) return NAL_SLICE;
+        } else if (codec_id == AV_CODEC_ID_HEVC) {
+            type = (header >> 1) & 0x3F;
+            if (type >= 32 && type <= 34) return NAL_PARAMETER_SET;
+            if (type >= 16 && type <= 23) return NAL_KEY_SLICE;
+            if (type <= 9) return NAL_SLICE;
+        }
+        return NAL_OTHER;
+    }
+
+    // True for access units the decoder needs to produce a keyframe: IDR/IRAP slices and parameter sets.
+    // Only the NAL headers up to the first slice are scanned, so P-frames are rejected cheaply.
+    bool ZCAM::isKeyPacket(const AVPacket *pkt, AVCodecID codec_id) {
+
+        if (pkt->flags & AV_PKT_FLAG_KEY) return true;
+        if (codec_id != AV_CODEC_ID_H264 && codec_id != AV_CODEC_ID_HEVC) return false;
+
+        const uint8_t *data = pkt->data;
+        bool parameter_sets = false;
+
+        for (int i = 0; i + 3 < pkt->size; i++) {
+            if (data[i] != 0x00 || data[i + 1] != 0x00 || data[i + 2] != 0x01) continue;
+            int nal_type;
+            NalKind kind = nalKind(codec_id, data[i + 3], nal_type);
+            if (kind == NAL_KEY_SLICE) return true;
+            if (kind == NAL_SLICE) return false;
+            if (kind == NAL_PARAMETER_SET) parameter_sets = true;
+            i += 3;
+        }
+
+        return parameter_sets;
+    }
+
+    // Keeps the newest copy of each parameter set NAL in front of the packet's first slice. Per-NAL RTP
+    // packetisation spreads them over several packets, so they are gathered until the set is complete.
+    void ZCAM::collectParameterSets(const AVPacket *pkt) {
+
+        AVCodecID codec_id = codec_ctx->codec_id;
+        if (codec_id != AV_CODEC_ID_H264 && codec_id != AV_CODEC_ID_HEVC) return;
+
+        const uint8_t *data = pkt->data;
+        int size = pkt->size;
+
+        auto at_start = [&](int i) { return i + 2 < size && data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01; };
+
+        int i = 0;
+        while (i + 3 < size) {
+            if (!at_start(i)) {
+                i++;
+                continue;
+            }
+            int begin = i + 3;
+            int nal_type;
+            NalKind kind = nalKind(codec_id, data[begin], nal_type);
+            if (kind == NAL_SLICE || kind == NAL_KEY_SLICE) break;
+
+            int end = begin;
+            while (end < size && !at_start(end)) end++;
+            i = end;
+            // The leading zero of a following 4-byte start code is not part of this unit
+            while (end > begin && data[end - 1] == 0x00) end--;
+
+            if (kind == NAL_PARAMETER_SET) keyframe_sets[nal_type].assign(data + begin, data + end);
+        }
+    }
+
+    // Annex B extradata from the gathered sets, empty until every set the codec needs was seen
+    vector<uint8_t> ZCAM::parameterSets() const {
+
+        static const uint8_t start_code[] = {0x00, 0x00, 0x00, 0x01};
+        vector<int> needed;
+        if (codec_ctx->codec_id == AV_CODEC_ID_H264) needed = {7, 8};
+        else if (codec_ctx->codec_id == AV_CODEC_ID_HEVC) needed = {32, 33, 34};
+
+        vector<uint8_t> sets;
+        for (int type : needed) {
+            auto it = keyframe_sets.find(type);
+            if (it == keyframe_sets.end()) return {};
+            sets.insert(sets.end(), start_code, start_code + 4);
+            sets.insert(sets.end(), it->second.begin(), it->second.end());
+        }
+        return sets;
+    }
+
+    bool ZCAM::wantPacket(const AVPacket *pkt) {
+        if (pkt->stream_index != video_stream_index) return false;
+        AVCodecID codec_id = codec_ctx->codec_id;
+        bool key = isKeyPacket(pkt, codec_id);
+        // Until a frame confirms the layout, keep the parameter sets the camera sends with its keyframes
+        if (!layout_confirmed && key) collectParameterSets(pkt);
+        return sampling == SAMPLE_ALL || key;
+    }
+
+    void ZCAM::loadLayout() {
+        ifstream file(layout_path);
+        if (!file.is_open()) return;
+        try {
+            json state = json::parse(file);
+            layout.stream_index = state.value("stream_index", -1);
+            layout.codec_id = state.value("codec_id", 0);
+            layout.width = state.value("width", 0);
+            layout.height = state.value("height", 0);
+            layout.pix_fmt = state.value("pix_fmt", -1);
+            string hex = state.value("extradata", string());
+            layout.extradata.clear();
+            for (size_t i = 0; i + 1 < hex.size(); i += 2)
+                layout.extradata.push_back(static_cast<uint8_t>(stoi(hex.substr(i, 2), nullptr, 16)));
+        } catch (const exception& e) {
+            layout = StreamLayout();
+            someLogger::getInstance()->log(camera_id + " ignoring unreadable stream cache " + layout_path);
+        }
+    }
+
+    // Opens the decoder straight from the cached layout. Parameters the SDP already carries win,
+    // the cache only fills in what it left out.
+    bool ZCAM::openCachedLayout() {
+
+        if (!stream_cache || layout.stream_index < 0 || layout.stream_index >= static_cast<int>(format_ctx->nb_streams) ||
+            format_ctx->streams[layout.stream_index]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)
+            return false;
+
+        AVCodecParameters *codecpar = avcodec_parameters_alloc();
+        if (!codecpar) return false;
+
+        if (avcodec_parameters_copy(codecpar, format_ctx->streams[layout.stream_index]->codecpar) < 0) {
+            avcodec_parameters_free(&codecpar);
+            return false;
+        }
+        if (codecpar->codec_id == AV_CODEC_ID_NONE) codecpar->codec_id = static_cast<AVCodecID>(layout.codec_id);
+        if (codecpar->width <= 0 || codecpar->height <= 0) {
+            codecpar->width = layout.width;
+            codecpar->height = layout.height;
+        }
+        if (codecpar->format < 0) codecpar->format = layout.pix_fmt;
+        if (codecpar->extradata_size <= 0 && !layout.extradata.empty()) {
+            codecpar->extradata = static_cast<uint8_t*>(av_mallocz(layout.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+            if (codecpar->extradata) {
+                memcpy(codecpar->extradata, layout.extradata.data(), layout.extradata.size());
+                codecpar->extradata_size = static_cast<int>(layout.extradata.size());
+            }
+        }
+
+        video_stream_index = layout.stream_index;
+        bool opened = openDecoder(codecpar);
+        avcodec_parameters_free(&codecpar);
+
+        if (!opened) video_stream_index = -1;
+        return opened;
+    }
+
+    // First frame after a decoder open: the layout it decoded with is written back if anything changed
+    void ZCAM::confirmLayout(const AVFrame *frame) {
+
+        layout_confirmed = true;
+        if (!stream_cache) return;
+
+        auto codecpar = format_ctx->streams[video_stream_index]->codecpar;
+
+        StreamLayout current;
+        current.stream_index = video_stream_index;
+        current.codec_id = codec_ctx->codec_id;
+        current.width = frame->width;
+        current.height = frame->height;
+        current.pix_fmt = hw_pix_fmt != AV_PIX_FMT_NONE ? codec_ctx->sw_pix_fmt : codec_ctx->pix_fmt;
+        // Sets from the stream only once complete, a lone SPS would make worse extradata than the SDP's
+        current.extradata = parameterSets();
+        if (current.extradata.empty() && codecpar->extradata_size > 0)
+            current.extradata.assign(codecpar->extradata, codecpar->extradata + codecpar->extradata_size);
+        else if (current.extradata.empty())
+            current.extradata = layout.extradata;
+
+        if (current.stream_index == layout.stream_index && current.codec_id == layout.codec_id &&
+            current.width == layout.width && current.height == layout.height &&
+            current.pix_fmt == layout.pix_fmt && current.extradata == layout.extradata)
+            return;
+
+        if (layout_cached)
+            someLogger::getInstance()->log(camera_id + " stream layout changed to " + to_string(current.width) + "x" +
+                                           to_string(current.height) + ", cache updated");
+        layout = current;
+
+        static const char digits[] = "0123456789abcdef";
+        string hex;
+        for (uint8_t byte : layout.extradata) {
+            hex += digits[byte >> 4];
+            hex += digits[byte & 0x0F];
+        }
+
+        error_code ec;
+        filesystem::create_directories(filesystem::path(layout_path).parent_path(), ec);
+        ofstream file(layout_path);
+        if (!file.is_open()) return;
+        json state;
+        state["stream_index"] = layout.stream_index;
+        state["codec_id"] = layout.codec_id;
+        state["width"] = layout.width;
+        state["height"] = layout.height;
+        state["pix_fmt"] = layout.pix_fmt;
+        state["extradata"] = hex;
+        file << state.dump();
+    }
+
+    // A cached layout still without a frame after max_packets is dropped - the budget of one getFrame(),
+    // so a single failed capture is enough - and the next connect sniffs the stream again
+    bool ZCAM::layoutFailed() {
+
+        if (layout_confirmed || !layout_cached || ++layout_packets < max_packets) return false;
+
+        someLogger::getInstance()->log(camera_id + " cached stream layout decoded nothing, detecting again");
+        layout = StreamLayout();
+        layout_cached = false;
+        error_code ec;
+        filesystem::remove(layout_path, ec);
+        return true;
+    }
+
+    void ZCAM::setConnectHook(function<void()> hook) {
+        lock_guard<mutex> lock(hook_mutex);
+        connect_hook = hook;
+    }
+
     bool ZCAM::detectVideoStream() {
 
+        SOME_TIMED_SCOPE(timer, "detectVideoStream");
+
         AVPacket *pkt = av_packet_alloc();
         if (!pkt) return false;
         
@@ -33,14 +316,9 @@
             int ret = av_read_frame(format_ctx, pkt);
             if (ret < 0) break;
             
-            if (pkt->size > 1000) {
-                uint8_t *data = pkt->data;
-                if (pkt->size >= 4 && 
-                    ((data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x00 && data[3] == 0x01) ||
-                     (data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x01))) {
-                    video_stream_index = pkt->stream_index;
-                    break;
-                }
+            if (pkt->size > 1000 && hasStartCode(pkt->data, pkt->size)) {
+                video_stream_index = pkt->stream_index;
+                break;
             }
             av_packet_unref(pkt);
         }
@@ -49,38 +327,166 @@
         
         if (video_stream_index < 0) return false;
         
-        // Setup H.264 decoder
-        codec = avcodec_find_decoder(AV_CODEC_ID_H264);
-        if (!codec) return false;
-        
-        codec_ctx = avcodec_alloc_context3(codec);
-        if (!codec_ctx) return false;
-        
-        codec_ctx->codec_type = AVMEDIA_TYPE_VIDEO;
-        codec_ctx->codec_id = AV_CODEC_ID_H264;
-        
-        return avcodec_open2(codec_ctx, codec, nullptr) >= 0;
+        if (openDecoder(format_ctx->streams[video_stream_index]->codecpar)) return true;
+
+        // A device that opened but can not decode this stream falls back to software for good
+        if (hw_type != AV_HWDEVICE_TYPE_NONE) {
+            someLogger::getInstance()->log(camera_id + " hardware decoder failed to open, decoding in software");
+            avcodec_free_context(&codec_ctx);
+            hw_type = AV_HWDEVICE_TYPE_NONE;
+            return openDecoder(format_ctx->streams[video_stream_index]->codecpar);
+        }
+
+        return false;
+    }
+
+    bool ZCAM::openDecoder(const AVCodecParameters *codecpar) {
+
+        someDecoderOptions options = decoder;
+        // Fed IDR access units only, every picture stands alone and frame threads would just hold them back
+        if (sampling != SAMPLE_ALL) options.thread_type = FF_THREAD_SLICE;
+
+        codec_ctx = someFFMpeg::openDecoder(codecpar, options, [this](AVCodecContext *ctx) {
+            codec_ctx = ctx;
+            codec = avcodec_find_decoder(ctx->codec_id);
+
+            if (sampling != SAMPLE_ALL) {
+                ctx->skip_frame = AVDISCARD_NONKEY;
+                if (sampling == SAMPLE_KEYFRAME_FAST) ctx->skip_loop_filter = AVDISCARD_ALL;
+            }
+
+            if (hw_type != AV_HWDEVICE_TYPE_NONE && !setupHWDecoder()) {
+                someLogger::getInstance()->log(camera_id + " hwaccel " + av_hwdevice_get_type_name(hw_type) + " unavailable, decoding in software");
+                hw_type = AV_HWDEVICE_TYPE_NONE;
+            }
+            return true;
+        });
+
+        return codec_ctx != nullptr;
+    }
+
+    bool ZCAM::setupHWDecoder() {
+
+        hw_pix_fmt = AV_PIX_FMT_NONE;
+        for (int i = 0;; i++) {
+            const AVCodecHWConfig *hw_config = avcodec_get_hw_config(codec, i);
+            if (!hw_config) break;
+            if ((hw_config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && hw_config->device_type == hw_type) {
+                hw_pix_fmt = hw_config->pix_fmt;
+                break;
+            }
+        }
+        if (hw_pix_fmt == AV_PIX_FMT_NONE) return false;
+
+        if (!hw_device_ctx &&
+            av_hwdevice_ctx_create(&hw_device_ctx, hw_type, hw_device.empty() ? nullptr : hw_device.c_str(), nullptr, 0) < 0)
+            return false;
+
+        codec_ctx->hw_device_ctx = av_buffer_ref(hw_device_ctx);
+        codec_ctx->opaque = this;
+        codec_ctx->get_format = getHWFormat;
+        return true;
+    }
+
+    // Picks the device surface format, or lets FFmpeg choose a software one if the stream can not use it
+    AVPixelFormat ZCAM::getHWFormat(AVCodecContext *ctx, const AVPixelFormat *formats) {
+        auto zcam = static_cast<ZCAM*>(ctx->opaque);
+        for (const AVPixelFormat *f = formats; *f != AV_PIX_FMT_NONE; f++)
+            if (*f == zcam->hw_pix_fmt) return *f;
+        return avcodec_default_get_format(ctx, formats);
+    }
+
+    // avcodec_receive_frame() plus the device-to-host copy - consumers always see system memory (NV12 for hw decode)
+    bool ZCAM::receiveFrame(AVFrame *frame) {
+
+        if (avcodec_receive_frame(codec_ctx, frame) != 0) return false;
+
+        if (frame->format == hw_pix_fmt && hw_pix_fmt != AV_PIX_FMT_NONE && !downloadFrame(frame)) {
+            av_frame_unref(frame);
+            return false;
+        }
+
+        if (!layout_confirmed) confirmLayout(frame);
+        return true;
+    }
+
+    // Copies a device surface into a pooled host buffer, so steady-state downloads do not hit the allocator
+    bool ZCAM::downloadFrame(AVFrame *frame) {
+
+        SOME_TIMED_SCOPE(timer, "captureFrame.download");
+
+        if (!sw_frame) sw_frame = av_frame_alloc();
+        if (!sw_frame || !frame->hw_frames_ctx) return false;
+
+        auto frames_ctx = reinterpret_cast<AVHWFramesContext*>(frame->hw_frames_ctx->data);
+        AVPixelFormat format = frames_ctx->sw_format;
+
+        int size = av_image_get_buffer_size(format, frame->width, frame->height, 32);
+        if (size <= 0) return false;
+        if (!download_pool || size != download_size) {
+            if (download_pool) av_buffer_pool_uninit(&download_pool);
+            download_pool = av_buffer_pool_init(size, nullptr);
+            download_size = size;
+        }
+
+        sw_frame->buf[0] = av_buffer_pool_get(download_pool);
+        if (!sw_frame->buf[0]) return false;
+        sw_frame->format = format;
+        sw_frame->width = frame->width;
+        sw_frame->height = frame->height;
+        av_image_fill_arrays(sw_frame->data, sw_frame->linesize, sw_frame->buf[0]->data, format, frame->width, frame->height, 32);
+
+        if (av_hwframe_transfer_data(sw_frame, frame, 0) < 0) {
+            av_frame_unref(sw_frame);
+            return false;
+        }
+        av_frame_copy_props(sw_frame, frame);
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, sw_frame);
+        return true;
     }
     
     bool ZCAM::initStream() {
         
+        SOME_TIMED_SCOPE(timer, "initializeStream");
+
         std::cout << "🔌 Connecting to RTSP..." << std::endl;
         
         format_ctx = avformat_alloc_context();
         if (!format_ctx) return false;
+
+        // Lets stopStream() break out of a blocking read
+        format_ctx->interrupt_callback.callback = interruptCallback;
+        format_ctx->interrupt_callback.opaque = this;
         
         AVDictionary *options = nullptr;
         av_dict_set(&options, "rtsp_transport", "tcp", 0);
         av_dict_set(&options, "stimeout", "10000000", 0);
-        av_dict_set(&options, "max_delay", "3000000", 0);
+        av_dict_set(&options, "timeout", "10000000", 0);  // FFmpeg >= 5 name of stimeout
+        av_dict_set(&options, "max_delay", to_string(decoder.max_delay_ms * 1000).c_str(), 0);
+        // Live path: hand packets on as they arrive instead of filling the probe buffer first
+        if (decoder.low_delay) av_dict_set(&options, "fflags", "nobuffer", 0);
         
         int ret = avformat_open_input(&format_ctx, rtsp_url.c_str(), nullptr, &options);
         av_dict_free(&options);
         
         if (ret < 0) return false;
         
-        // Skip stream info analysis, use manual detection
-        if (!detectVideoStream()) return false;
+        // Skip stream info analysis: the cached layout if there is one, manual detection otherwise
+        bool cached = openCachedLayout();
+        if (!cached && !detectVideoStream()) return false;
+
+        layout_cached = cached;
+        layout_confirmed = false;
+        layout_packets = 0;
+        keyframe_sets.clear();
+
+        function<void()> hook;
+        {
+            lock_guard<mutex> lock(hook_mutex);
+            hook = connect_hook;
+        }
+        if (hook) hook();
         
         cout << "✅ RTSP stream ready" << std::endl;
         return true;
@@ -90,32 +496,159 @@
         
         if (!format_ctx || !codec_ctx) return nullptr;
         
-        AVPacket *packet = av_packet_alloc();
-        AVFrame *frame = av_frame_alloc();
+        if (!capture_packet) capture_packet = av_packet_alloc();
+        AVFrame *frame = frames.acquire();
         
-        if (!packet || !frame) {
-            if (packet) av_packet_free(&packet);
-            if (frame) av_frame_free(&frame);
+        if (!capture_packet || !frame) {
+            frames.release(frame);
             return nullptr;
         }
         
-        while (true) {
-            int ret = av_read_frame(format_ctx, packet);
+        // Packets until the first decodable frame - read and decode time are summed across them
+        static someHistogram& read_histogram = someMetrics::histogram("captureFrame.read");
+        static someHistogram& decode_histogram = someMetrics::histogram("captureFrame.decode");
+        uint64_t read_us = 0, decode_us = 0;
+        bool decoded = false;
+
+        // Bounded, so a stream that never yields a video frame (audio only, stale layout) fails the cycle
+        for (int packets = 0; packets < max_packets; packets++) {
+            auto start = chrono::steady_clock::now();
+            int ret = av_read_frame(format_ctx, capture_packet);
+            auto read_end = chrono::steady_clock::now();
+            read_us += chrono::duration_cast<chrono::microseconds>(read_end - start).count();
             
             if (ret < 0) break;
+
+            if (layoutFailed()) {
+                av_packet_unref(capture_packet);
+                break;
+            }
             
-            if (packet->stream_index == video_stream_index) {
-                ret = avcodec_send_packet(codec_ctx, packet);
-                if (ret == 0) {
-                    ret = avcodec_receive_frame(codec_ctx, frame);
-                    if (ret == 0) {
-                        av_packet_free(&packet);
-                        return frame;
+            if (wantPacket(capture_packet)) {
+                ret = avcodec_send_packet(codec_ctx, capture_packet);
+                decoded = ret == 0 && receiveFrame(frame);
+                decode_us += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - read_end).count();
+            }
+            av_packet_unref(capture_packet);
+            if (decoded) break;
+        }
+
+        read_histogram.record(read_us);
+        decode_histogram.record(decode_us);
+        if (decoded) return frame;
+        
+        frames.release(frame);
+        return nullptr;
+    }
+
+    int ZCAM::interruptCallback(void *opaque) {
+        return static_cast<ZCAM*>(opaque)->stopping ? 1 : 0;
+    }
+
+    bool ZCAM::startStream() {
+
+        lock_guard<mutex> lock(session_mutex);
+
+        if (streaming) return true;
+
+        stopping = false;
+        streaming = true;
+        frames.open();
+        drainer = thread(&ZCAM::drainStream, this);
+
+        return true;
+    }
+
+    void ZCAM::stopStream() {
+
+        lock_guard<mutex> lock(session_mutex);
+
+        if (!streaming) return;
+
+        {
+            // Under the drainer's wait mutex, so a drainer between its predicate check and blocking still wakes
+            lock_guard<mutex> backoff_lock(backoff_mutex);
+            stopping = true;
+            streaming = false;
+        }
+        backoff_cv.notify_all();
+        frames.close();
+
+        if (drainer.joinable()) drainer.join();
+    }
+
+    // Reads the socket continuously so the RTSP buffer never backs up, decoding once into
+    // the shared frame ring. Reconnects with exponential backoff on errors.
+    void ZCAM::drainStream() {
+
+        AVPacket *packet = av_packet_alloc();
+        AVFrame *frame = av_frame_alloc();
+        int backoff = 1;
+
+        while (streaming && packet && frame) {
+
+            if (!format_ctx) {
+                if (!initStream()) {
+                    cleanup();
+                    someLogger::getInstance()->log(camera_id + " stream connect failed, retry in " + to_string(backoff) + "s");
+                    unique_lock<mutex> lock(backoff_mutex);
+                    backoff_cv.wait_for(lock, chrono::seconds(backoff), [this] { return !streaming; });
+                    backoff = min(backoff * 2, max_backoff);
+                    continue;
+                }
+            }
+
+            int ret = av_read_frame(format_ctx, packet);
+
+            if (ret == AVERROR(EAGAIN)) continue;
+
+            if (ret < 0) {
+                if (streaming) {
+                    char errbuf[AV_ERROR_MAX_STRING_SIZE];
+                    av_make_error_string(errbuf, AV_ERROR_MAX_STRING_SIZE, ret);
+                    someLogger::getInstance()->log(camera_id + " stream read error: " + errbuf + ", reconnecting");
+                }
+                cleanup();
+                continue;
+            }
+
+            if (layoutFailed()) {
+                av_packet_unref(packet);
+                cleanup();
+                continue;
+            }
+
+            if (wantPacket(packet)) {
+                // Reads here block on the camera's frame pacing, only decode cost is worth timing
+                SOME_TIMED_SCOPE(timer, "captureFrame.decode");
+                if (avcodec_send_packet(codec_ctx, packet) == 0) {
+                    while (receiveFrame(frame)) {
+                        frames.push(frame);
+                        backoff = 1;
                     }
                 }
             }
+
+            av_packet_unref(packet);
         }
-        
+
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        cleanup();
+    }
+
+    // Returns a new reference to the newest frame after `seq` (caller frees), or nullptr on timeout
+    AVFrame *ZCAM::waitFrame(uint64_t& seq, int timeout_ms) {
+        if (!streaming) return nullptr;
+        return frames.wait(seq, timeout_ms);
+    }
+
+    // Newest decoded frame right away, waiting only if the session has not produced one yet
+    AVFrame *ZCAM::latestFrame(int timeout_ms) {
+        if (!streaming) return nullptr;
+        uint64_t seq = 0;
+        AVFrame *frame = frames.latest(&seq);
+        if (!frame) frame = frames.wait(seq, timeout_ms);
         return frame;
     }
 
@@ -0,0 +1,131 @@
+#include <zcamControl.h>
+
+#include <iostream>
+#include <chrono>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+#include <someMetrics.h>
+
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+const size_t MAX_IDLE = 4;
+
+// tcp_stream deadlines only apply to async operations, so each step is one, run to completion on the
+// connection's own io_context; an expired deadline closes the socket and fails it with error::timeout
+struct ZCAMControl::Connection {
+    net::io_context ioc;
+    beast::tcp_stream stream;
+    Connection() : stream(ioc) {}
+
+    template <class Start>
+    void await(int seconds, Start start) {
+        beast::error_code result;
+        stream.expires_after(chrono::seconds(seconds));
+        start([&result](beast::error_code ec, auto&&...) { result = ec; });
+        ioc.restart();
+        ioc.run();
+        if (result) throw beast::system_error{result};
+    }
+};
+
+ZCAMControl::ZCAMControl(const string& camera_ip, const string& port) : camera_ip(camera_ip), port(port) {
+}
+
+ZCAMControl::~ZCAMControl() {
+}
+
+unique_ptr<ZCAMControl::Connection> ZCAMControl::reuse() {
+    lock_guard<mutex> lock(pool_mutex);
+    if (idle.empty()) return nullptr;
+    auto conn = std::move(idle.back());
+    idle.pop_back();
+    return conn;
+}
+
+unique_ptr<ZCAMControl::Connection> ZCAMControl::connect() {
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        if (endpoints.empty()) {
+            tcp::resolver resolver(ioc);
+            endpoints = resolver.resolve(camera_ip, port);
+        }
+    }
+    auto conn = make_unique<Connection>();
+    conn->await(timeout, [&](auto handler) { conn->stream.async_connect(endpoints, handler); });
+    return conn;
+}
+
+void ZCAMControl::release(unique_ptr<Connection> conn) {
+    conn->stream.expires_never();
+    lock_guard<mutex> lock(pool_mutex);
+    if (idle.size() < MAX_IDLE) idle.push_back(std::move(conn));
+}
+
+// GET on a kept-alive connection, a stale reused connection is retried once. status is 0 on transport errors.
+someNetwork::Response ZCAMControl::get(const string& endpoint) {
+
+    SOME_TIMED_SCOPE(timer, "someNetwork.ctrl");
+
+    someNetwork::Response response;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+
+        auto conn = attempt == 0 ? reuse() : nullptr;
+        bool reused = conn != nullptr;
+
+        try {
+            if (!conn) conn = connect();
+
+            http::request<http::empty_body> req{http::verb::get, endpoint, 11};
+            req.set(http::field::host, camera_ip);
+            req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+            req.keep_alive(true);
+
+            conn->await(timeout, [&](auto handler) { http::async_write(conn->stream, req, handler); });
+
+            beast::flat_buffer buffer;
+            http::response<http::string_body> res;
+            conn->await(timeout, [&](auto handler) { http::async_read(conn->stream, buffer, res, handler); });
+
+            response.str = res.body();
+            response.status = res.result_int();
+            if (!response.str.empty()) {
+                try {
+                    response.json = nlohmann::json::parse(response.str);
+                } catch(exception const&e) {
+
+                }
+            }
+
+            if (res.keep_alive()) release(std::move(conn));
+
+            return response;
+        }
+        catch(beast::system_error const& se) {
+            if (reused && attempt == 0) continue;
+            std::cerr << "ZCAMControl " << endpoint << " Error: " << se.code().message() << std::endl;
+            break;
+        }
+    }
+
+    response.status = 0;
+    return response;
+}
+
+// One after another on the kept-alive connection: each is a few ms on the camera's LAN, less than
+// a thread or another connection per request would cost. A camera that did not answer one request
+// is not asked the rest, they come back with status 0.
+vector<someNetwork::Response> ZCAMControl::getAll(const vector<string>& endpoints) {
+
+    vector<someNetwork::Response> results;
+    for (auto& endpoint : endpoints) {
+        if (!results.empty() && results.back().status == 0) {
+            results.push_back(results.back());
+            continue;
+        }
+        results.push_back(get(endpoint));
+    }
+    return results;
+}
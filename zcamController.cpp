@@ -13,17 +13,12 @@
 
 #include <someLogger.h>
 #include <someNetwork.h>
+#include <someMetrics.h>
 #include <someFFMpeg.h>
+#include <someUploader.h>
 
 using namespace std;
 
-    // FFmpeg components
-    AVFormatContext *format_ctx = nullptr;
-    AVCodecContext *codec_ctx = nullptr;
-    const AVCodec *codec = nullptr;  // Use const AVCodec* for newer FFmpeg versions
-    SwsContext *sws_ctx = nullptr;
-    int video_stream_index = -1;
-        
     // ZCAM E2 parameter ranges
     vector<int> iso_values = {400,500,640,800,1000,1250,1600,2000,2500,3200,4000,5000,6400,8000,10000,12800,16000,20000,25600,32000,40000,51200,64000};
     vector<string> iris_values = {"1.4", "1.6", "1.8", "2.0", "2.2", "2.5", "2.8", "3.2", "3.5", "4.0", "4.5", "5.0", "5.6", "6.3", "7.1", "8.0", "9.0", "10", "11", "13", "14", "16"};
@@ -32,7 +27,7 @@ using namespace std;
     double confidence_threshold = 0.6;  // Only apply changes if confidence > 60%
     int changes_applied = 0;
 
-    ZCAMController::ZCAMController(const json& config, const int cam_idx) {
+    ZCAMController::ZCAMController(const json& config, const int cam_idx, ZCAM *source) {
 
         root = config["files"].get<string>();
         host = config["host"].get<string>();
@@ -43,6 +38,12 @@ using namespace std;
         if (config.count("auto")>0)
             auto_adjust = config["auto"].get<bool>();
 
+        if (config.count("persistent")>0)
+            persistent = config["persistent"].get<bool>();
+
+        if (config.count("interval")>0)
+            interval = config["interval"].get<int>();
+
         camera_ip = config["ipaddr"][cam_idx].get<string>();
         camera_id = config["cameras"][cam_idx].get<string>();
 
@@ -59,11 +60,69 @@ using namespace std;
         if (config.count("end_hour") > 0)
             end_hour = config["end_hour"].get<int>();
 
-        // Initialize FFmpeg
-        #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
-        av_register_all();
-        #endif
-        avformat_network_init();
+        // Sky/horizon rows above top_margin are excluded from metering in every mode, an explicit roi overrides it
+        if (config.count("top_margin") > 0)
+            metering.top_margin = metering.roi[1] = config["top_margin"][cam_idx].get<int>();
+
+        if (config.count("metering") > 0) {
+            auto jmeter = config["metering"];
+            string mode = jmeter.value("mode", "uniform");
+            if (mode == "roi") metering.mode = MeteringConfig::ROI;
+            else if (mode == "zones") metering.mode = MeteringConfig::ZONES;
+            metering.step = max(1, jmeter.value("step", 1));
+            // "roi" is a list of [x0, y0, x1, y1] per camera
+            if (jmeter.count("roi") > 0 && jmeter["roi"].size() > static_cast<size_t>(cam_idx))
+                for (int i = 0; i < 4; i++) metering.roi[i] = jmeter["roi"][cam_idx][i].get<int>();
+            metering.rows = max(1, jmeter.value("rows", 3));
+            metering.cols = max(1, jmeter.value("cols", 3));
+            // "weights" is one flat rows*cols list, or a list of them per camera
+            if (jmeter.count("weights") > 0) {
+                auto jweights = jmeter["weights"];
+                if (!jweights.empty() && jweights[0].is_array()) jweights = jweights[min(cam_idx, static_cast<int>(jweights.size()) - 1)];
+                metering.weights = jweights.get<vector<int>>();
+            }
+            if (metering.weights.size() != static_cast<size_t>(metering.rows * metering.cols))
+                metering.weights.assign(metering.rows * metering.cols, 1);
+        }
+
+        // The dashboard shows caminfo thumbnails, so "preview" (by name) or the smallest rendition is referenced
+        renditions = someFFMpeg::renditions(config);
+        preview = renditions.front();
+        for (auto& rendition : renditions) {
+            if (config.count("preview") > 0 ? rendition.name == config["preview"].get<string>() :
+                rendition.width > 0 && (preview.width == 0 || rendition.width < preview.width))
+                preview = rendition;
+        }
+
+        store = SnapshotStore::forCamera(config, camera_id);
+        if (store && config["store"].is_object())
+            store_rendition = config["store"].value("rendition", store_rendition);
+
+        owns_zcam = source == nullptr;
+        zcam = owns_zcam ? new ZCAM(config, cam_idx) : source;
+
+        control = new ZCAMControl(camera_ip, config.value("ctrl_port", string("80")));
+
+        // /ctrl endpoint that makes the encoder send an IDR, so a fresh connection decodes right away
+        // instead of waiting out the rest of the GOP
+        if (config.count("idr_request") > 0) {
+            string endpoint = config["idr_request"].get<string>();
+            zcam->setConnectHook([this, endpoint]() { control->get(endpoint); });
+        }
+        uploader = someUploader::getInstance(config);
+
+        pipeline = new FramePipeline(config, cam_idx);
+        focus_monitor = dynamic_cast<FocusMonitor*>(pipeline->find("focus"));
+
+        if (config.count("analysis") > 0 || pipeline->needsAnalysis())
+            analyzer = new FrameAnalyzer(config);
+
+        // "exposure_control": true, or an object whose "mode" is "model" (the default) rather than "ladder"
+        auto jcontrol = config.count("exposure_control") > 0 ? config["exposure_control"] : json(false);
+        if (jcontrol.is_object() ? jcontrol.value("mode", "model") == "model" : jcontrol.is_boolean() && jcontrol.get<bool>()) {
+            exposure_model = new ExposureModel(config, cam_idx);
+            exposure_model->setOptions(iso_values, iris_values, settings.min_iris, settings.max_iris);
+        }
         
         cout << "🎥 ZCAM Simple Frame Capture" << endl;
         cout << "📡 RTSP URL: " << rtsp_url << endl;
@@ -71,28 +130,22 @@ using namespace std;
     }
     
     ZCAMController::~ZCAMController() {
+        zcam->setConnectHook(nullptr);
         cleanup();
-        avformat_network_deinit();
+        if (owns_zcam) delete zcam;
+        delete control;
+        delete pipeline;
+        delete exposure_model;
+        delete analyzer;
     }
     
     void ZCAMController::cleanup() {
 
-        if (sws_ctx) {
-            sws_freeContext(sws_ctx);
-            sws_ctx = nullptr;
-        }
-        
-        if (codec_ctx) {
-            avcodec_free_context(&codec_ctx);
-            codec_ctx = nullptr;
+        if (owns_zcam) {
+            zcam->stopStream();
+            zcam->closeStream();
         }
-        
-        if (format_ctx) {
-            avformat_close_input(&format_ctx);
-            format_ctx = nullptr;
-        }
-        
-        video_stream_index = -1;
+
         std::cout << "🧹 Cleaned up" << std::endl;
     }
 
@@ -100,9 +153,7 @@ using namespace std;
 
         std::cout << "🌐 HTTP Request: " << endpoint << std::endl;
 
-        someNetwork net;
-
-        auto response = net.http_get(camera_ip, endpoint);
+        auto response = control->get(endpoint);
 
         cout << "HTTP Response: " << response.str << " " << response.status << endl;
         
@@ -113,24 +164,31 @@ using namespace std;
 
         cout << "🔍 Reading current ZCAM E8 Z2 settings..." << endl;
         
-        // Get current ISO - using your working JS format
-        auto resp = httpRequest("/ctrl/get?k=iso");
+        // The three reads share one kept-alive connection, so a cycle costs a single connect at most
+        auto responses = control->getAll({"/ctrl/get?k=iso", "/ctrl/get?k=iris", "/ctrl/temperature"});
+
+        auto resp = responses[0];
+        cout << "HTTP Response: " << resp.str << " " << resp.status << endl;
         if (resp.status == 200) {
             if (resp.json.count("value") > 0) 
                 settings.iso = stoi(resp.json["value"].get<string>());
-            // camera_state.iso_options = resp.json["opts"]; 
+            // Option lists do not change while the camera is up, fetch them once
+            if (camera_state.iso_options.empty() && resp.json.count("opts") > 0)
+                camera_state.iso_options = resp.json["opts"];
         }
 
-        resp = httpRequest("/ctrl/get?k=iris");
+        resp = responses[1];
+        cout << "HTTP Response: " << resp.str << " " << resp.status << endl;
         if (resp.status == 200 && resp.json.count("value") > 0) {
             settings.iris = resp.json["value"].get<string>();
-            // camera_state.iris_options = resp.json["opts"]; 
+            if (camera_state.iris_options.empty() && resp.json.count("opts") > 0)
+                camera_state.iris_options = resp.json["opts"];
         }
 
-        resp = httpRequest("/ctrl/temperature");
+        resp = responses[2];
+        cout << "HTTP Response: " << resp.str << " " << resp.status << endl;
         if (resp.status == 200 && resp.json.count("msg") > 0) {
             camera_state.temperature = stoi(resp.json["msg"].get<string>());
-            // camera_state.iris_options = resp.json["opts"]; 
         }
 
         return resp.status == 200;
@@ -138,6 +196,8 @@ using namespace std;
     
     bool ZCAMController::applySetting(const std::string& param, const std::string& value) {
 
+        SOME_TIMED_SCOPE(timer, "applySetting");
+
         string endpoint = "/ctrl/set?" + param + "=" + value;
         auto resp = httpRequest(endpoint);
         if (resp.json.count("code")) {
@@ -150,16 +210,14 @@ using namespace std;
     ExposureMetrics ZCAMController::analyzeExposure(const vector<uint8_t>& rgb_data, int width, int height) {
         
         if (rgb_data.empty()) return metrics;
-        
-        metrics.total_pixels = width * height;
-        
-        double sum_brightness = 0.0;
-        double sum_squared = 0.0;
-        int highlight_count = 0;
-        int shadow_count = 0;
+
+        SOME_TIMED_SCOPE(timer, "analyzeExposure");
+
+        LumaStats stats;
+        int total_pixels = width * height;
         
         // Analyze pixels
-        for (int i = 0; i < metrics.total_pixels; i++) {
+        for (int i = 0; i < total_pixels; i++) {
             size_t pixel_idx = static_cast<size_t>(i) * 3;
             if (pixel_idx + 2 < rgb_data.size()) {
                 uint8_t r = rgb_data[pixel_idx];
@@ -167,15 +225,79 @@ using namespace std;
                 uint8_t b = rgb_data[pixel_idx + 2];
                 
                 uint8_t gray = static_cast<uint8_t>(0.299 * r + 0.587 * g + 0.114 * b);
-                
-                sum_brightness += gray;
-                sum_squared += gray * gray;
-                
-                if (gray >= 250) highlight_count++;
-                if (gray <= 5) shadow_count++;
+                stats.add(gray);
             }
         }
         
+        return exposureFromStats(stats);
+    }
+
+    // Meters the decoded luma plane directly - no RGB conversion, integer histogram only
+    ExposureMetrics ZCAMController::analyzeExposure(const AVFrame *frame) {
+
+        if (!frame || !frame->data[0] || frame->width <= 0 || frame->height <= 0) return metrics;
+
+        SOME_TIMED_SCOPE(timer, "analyzeExposure");
+
+        const uint8_t *plane = frame->data[0];
+        int linesize = frame->linesize[0];
+
+        // Uniform metering covers the frame below top_margin, roi and zones only the configured window
+        int x0 = 0, y0 = std::min(std::max(0, metering.top_margin), frame->height - 1), x1 = frame->width, y1 = frame->height;
+        if (metering.mode != MeteringConfig::UNIFORM) {
+            x0 = std::min(std::max(0, metering.roi[0]), frame->width - 1);
+            y0 = std::min(std::max(0, metering.roi[1]), frame->height - 1);
+            if (metering.roi[2] > x0) x1 = std::min(metering.roi[2], frame->width);
+            if (metering.roi[3] > y0) y1 = std::min(metering.roi[3], frame->height);
+        }
+
+        LumaStats stats;
+
+        // The fused pass returns full-range zone histograms, uniform and roi metering are a single zone
+        bool zones = metering.mode == MeteringConfig::ZONES;
+        if (analyzer) analysis = analyzer->analyze(frame, x0, y0, x1, y1, zones ? metering.rows : 1, zones ? metering.cols : 1);
+        if (analyzer && !analysis.zones.empty()) {
+            for (size_t i = 0; i < analysis.zones.size(); i++)
+                stats.merge(analysis.zones[i], zones ? max(0, metering.weights[i]) : 1);
+            return exposureFromStats(stats);
+        }
+
+        if (zones) {
+            // Integer weights act as pixel repeat counts, so the weighted histogram stays exact
+            int zone_w = (x1 - x0) / metering.cols;
+            int zone_h = (y1 - y0) / metering.rows;
+            for (int r = 0; r < metering.rows; r++)
+                for (int c = 0; c < metering.cols; c++) {
+                    int weight = metering.weights[r * metering.cols + c];
+                    if (weight <= 0 || zone_w <= 0 || zone_h <= 0) continue;
+                    LumaStats zone;
+                    const uint8_t *origin = plane + static_cast<size_t>(y0 + r * zone_h) * linesize + x0 + c * zone_w;
+                    LumaKernel::accumulate(origin, linesize, zone_w, zone_h, zone, metering.step);
+                    stats.merge(zone, weight);
+                }
+        } else {
+            const uint8_t *origin = plane + static_cast<size_t>(y0) * linesize + x0;
+            LumaKernel::accumulate(origin, linesize, x1 - x0, y1 - y0, stats, metering.step);
+        }
+
+        // Limited range luma (16-235) is stretched to full range so thresholds match the RGB path
+        if (!FrameAnalyzer::fullRange(frame)) stats.expandLimitedRange();
+
+        return exposureFromStats(stats);
+    }
+
+    ExposureMetrics ZCAMController::exposureFromStats(const LumaStats& stats) {
+
+        metrics.total_pixels = static_cast<int>(stats.count);
+        
+        double sum_brightness = static_cast<double>(stats.sum);
+        double sum_squared = static_cast<double>(stats.sum_squared);
+        uint64_t highlight_count = 0;
+        uint64_t shadow_count = 0;
+
+        for (int v = 250; v < 256; v++) highlight_count += stats.histogram[v];
+        for (int v = 0; v <= 5; v++) shadow_count += stats.histogram[v];
+        
         if (metrics.total_pixels > 0) {
             metrics.brightness = sum_brightness / metrics.total_pixels;
             
@@ -325,139 +447,99 @@ using namespace std;
         return changed;
     }
     
-    bool ZCAMController::captureFrame(std::vector<uint8_t>& rgb_data, int& width, int& height) {
-        if (!format_ctx || !codec_ctx) return false;
-        
-        AVPacket *packet = av_packet_alloc();
-        AVFrame *frame = av_frame_alloc();
-        AVFrame *rgb_frame = av_frame_alloc();
-        
-        if (!packet || !frame || !rgb_frame) {
-            if (packet) av_packet_free(&packet);
-            if (frame) av_frame_free(&frame);
-            if (rgb_frame) av_frame_free(&rgb_frame);
-            return false;
-        }
-        
-        bool success = false;
-        int packets_read = 0;
-        
-        while (packets_read < 100 && keep_running) {
-            int ret = av_read_frame(format_ctx, packet);
-            packets_read++;
-            
-            if (ret < 0) break;
-            
-            if (packet->stream_index == video_stream_index) {
-                ret = avcodec_send_packet(codec_ctx, packet);
-                if (ret == 0) {
-                    ret = avcodec_receive_frame(codec_ctx, frame);
-                    if (ret == 0) {
-
-                        auto now = std::chrono::system_clock::now();
-                        auto time_t = std::chrono::system_clock::to_time_t(now);       
-                        std::stringstream ss;
-                        ss << root << "zcam/" << camera_id << std::put_time(std::localtime(&time_t), "%H%M");
-                        snapshot = ss.str();
-                        someFFMpeg::saveAVFrameAsJPEG(frame, snapshot + ".JPG", 100);
-
-                        width = frame->width;
-                        height = frame->height;
-                        
-                        if (!sws_ctx) {
-                            sws_ctx = sws_getContext(
-                                width, height, (AVPixelFormat)frame->format,
-                                width, height, AV_PIX_FMT_RGB24,
-                                SWS_BILINEAR, nullptr, nullptr, nullptr
-                            );
-                        }
-                        
-                        if (sws_ctx) {
-                            int rgb_size = av_image_get_buffer_size(AV_PIX_FMT_RGB24, width, height, 1);
-                            rgb_data.resize(rgb_size);
-                            
-                            av_image_fill_arrays(rgb_frame->data, rgb_frame->linesize,
-                                                rgb_data.data(), AV_PIX_FMT_RGB24, width, height, 1);
-                            
-                            sws_scale(sws_ctx, frame->data, frame->linesize, 0, height,
-                                    rgb_frame->data, rgb_frame->linesize);
-                            
-                            success = true;
-                        }
-                        break;
-                    }
-                }
+    // Jumps straight to the setting the model predicts for the target brightness. On the persistent stream the
+    // result is measured a moment later, fed back into the model and refined, so exposure settles within one cycle.
+    bool ZCAMController::convergeExposure() {
+
+        bool changed = false;
+
+        for (int step = 0; step < exposure_model->steps; step++) {
+
+            if (!exposure_model->needsCorrection(metrics.brightness, settings.target_brightness, settings.brightness_tolerance))
+                break;
+
+            int iso = settings.iso;
+            string iris = settings.iris;
+            if (!exposure_model->predict(metrics.brightness, settings.target_brightness, iso, iris)) break;
+
+            int old_iso = settings.iso;
+            string old_iris = settings.iris;
+            double before = metrics.brightness;
+
+            bool applied = false;
+            if (iris != settings.iris && applySetting("iris", iris)) {
+                settings.iris = iris;
+                applied = true;
             }
-            av_packet_unref(packet);
+            if (iso != settings.iso && applySetting("iso", std::to_string(iso))) {
+                settings.iso = iso;
+                applied = true;
+            }
+            if (!applied) break;
+            changed = true;
+
+            someLogger::getInstance()->log(camera_id + " exposure B=" + to_string(static_cast<int>(before)) +
+                " ISO " + to_string(old_iso) + "→" + to_string(settings.iso) + " f/" + old_iris + "→f/" + settings.iris);
+
+            // Without the live stream the result is only seen next cycle
+            if (!persistent) break;
+
+            this_thread::sleep_for(chrono::milliseconds(exposure_model->settle_ms));
+            AVFrame *frame = zcam->waitFrame(frame_seq);
+            if (!frame) break;
+            analyzeExposure(frame);
+            zcam->releaseFrame(frame);
+
+            exposure_model->observe(old_iso, old_iris, before, settings.iso, settings.iris, metrics.brightness);
+            cout << "   Brightness after step " << step + 1 << ": " << metrics.brightness << "/255" << endl;
         }
-        
-        av_packet_free(&packet);
-        av_frame_free(&frame);
-        av_frame_free(&rgb_frame);
-        
-        return success;
+
+        return changed;
     }
-    
-    bool ZCAMController::detectVideoStream() {
 
-        AVPacket *pkt = av_packet_alloc();
-        if (!pkt) return false;
-        
-        for (int i = 0; i < 30; i++) {
-            int ret = av_read_frame(format_ctx, pkt);
-            if (ret < 0) break;
-            
-            if (pkt->size > 1000) {
-                uint8_t *data = pkt->data;
-                if (pkt->size >= 4 && 
-                    ((data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x00 && data[3] == 0x01) ||
-                     (data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x01))) {
-                    video_stream_index = pkt->stream_index;
-                    break;
-                }
-            }
-            av_packet_unref(pkt);
-        }
-        
-        av_packet_free(&pkt);
-        
-        if (video_stream_index < 0) return false;
-        
-        // Setup H.264 decoder
-        codec = avcodec_find_decoder(AV_CODEC_ID_H264);
-        if (!codec) return false;
-        
-        codec_ctx = avcodec_alloc_context3(codec);
-        if (!codec_ctx) return false;
-        
-        codec_ctx->codec_type = AVMEDIA_TYPE_VIDEO;
-        codec_ctx->codec_id = AV_CODEC_ID_H264;
+    // Grabs a decoded frame and saves the cycle snapshot (stored ones after analysis, see storeSnapshot);
+    // caller hands the frame back with zcam->releaseFrame()
+    AVFrame* ZCAMController::captureFrame() {
+
+        SOME_TIMED_SCOPE(timer, "captureFrame");
+
+        AVFrame *frame = persistent ? zcam->waitFrame(frame_seq) : zcam->getFrame();
         
-        return avcodec_open2(codec_ctx, codec, nullptr) >= 0;
+        if (!frame) return nullptr;
+
+        auto now = std::chrono::system_clock::now();
+        auto time_t = std::chrono::system_clock::to_time_t(now);       
+        std::stringstream ss;
+        ss << root << "zcam/" << camera_id << std::put_time(std::localtime(&time_t), "%H%M");
+        snapshot = ss.str();
+        // Encoding a 4K frame takes tens of ms, hand it off so analysis starts right after decode
+        if (!store) someFFMpeg::saveRenditionsAsync(frame, snapshot, renditions);
+        
+        return frame;
     }
-    
-    bool ZCAMController::initializeStream() {
 
-        std::cout << "🔌 Connecting to RTSP..." << std::endl;
-        
-        format_ctx = avformat_alloc_context();
-        if (!format_ctx) return false;
-        
-        AVDictionary *options = nullptr;
-        av_dict_set(&options, "rtsp_transport", "tcp", 0);
-        av_dict_set(&options, "stimeout", "10000000", 0);
-        av_dict_set(&options, "max_delay", "3000000", 0);
-        
-        int ret = avformat_open_input(&format_ctx, rtsp_url.c_str(), nullptr, &options);
-        av_dict_free(&options);
-        
-        if (ret < 0) return false;
-        
-        // Skip stream info analysis, use manual detection
-        if (!detectVideoStream()) return false;
-        
-        cout << "✅ RTSP stream ready" << std::endl;
-        return true;
+    // Encoded off-thread like the flat files; the index record carries the metrics measured on this frame
+    void ZCAMController::storeSnapshot(const AVFrame *frame) {
+
+        SnapshotStore::Entry entry;
+        entry.time = someLogger::timeSinceEpochMilli();
+        entry.iso = static_cast<uint32_t>(settings.iso);
+        entry.iris = static_cast<float>(stod(settings.iris));
+        entry.brightness = static_cast<float>(metrics.brightness);
+        entry.contrast = static_cast<float>(metrics.contrast);
+        entry.exposure = static_cast<float>(metrics.exposure_score);
+        entry.focus = focus_monitor ? static_cast<float>(focus_monitor->level()) : -1;
+
+        SnapshotStore *target = store;
+        string stored = store_rendition;
+        string shown = preview.name;
+        string base = snapshot;
+        // The preview stays a flat file even when it is the stored rendition, caminfo links to it
+        someFFMpeg::encodeRenditionsAsync(frame, renditions, [=](const someRendition& rendition, const vector<uint8_t>& jpeg) {
+            if (rendition.name == stored) target->append(entry, jpeg);
+            if (rendition.name != stored || rendition.name == shown)
+                someFFMpeg::writeJPEG(someFFMpeg::renditionPath(base, rendition), jpeg);
+        });
     }
 
     void ZCAMController::shutdown() {
@@ -476,35 +558,42 @@ using namespace std;
 
         if (!isOperatingHours()) {
             std::cout << "😴 Outside operating hours, sleeping..." << std::endl;
+            zcam->stopStream();
             return false;
         }
 
-        if (!initializeStream()) {
+        if (persistent) {
+            zcam->startStream();
+        } else if (!zcam->initStream()) {
             std::cout << "❌ Failed to initialize stream" << std::endl;
+            zcam->closeStream();
             return false;
         }
         
         if (!readCurrentSettings()) {
             std::cout << "❌ Failed to read camera settings" << std::endl;
+            if (!persistent) zcam->closeStream();
             return false;
         }
         
         cout << "✅ Current settings: ISO " << settings.iso << ", f/" << settings.iris << std::endl;
             
-        std::vector<uint8_t> rgb_data;
-        int width, height;
-
         bool changed = false;
 
         auto iso = settings.iso;
         auto iris = settings.iris;
             
-        if (captureFrame(rgb_data, width, height)) {
-            ExposureMetrics metrics = analyzeExposure(rgb_data, width, height);    
+        AVFrame *frame = captureFrame();
+
+        if (frame) {
+            ExposureMetrics metrics = analyzeExposure(frame);
+            pipeline->run(frame, analysis);
+            if (store) storeSnapshot(frame);
+            zcam->releaseFrame(frame);
                 std::cout << "   Brightness: " << std::fixed << std::setprecision(1) 
                          << metrics.brightness << "/255, Contrast: " << metrics.contrast 
                          << ", Score: " << metrics.exposure_score << "/100" << std::endl;
-                if (auto_adjust) changed = adjustExposure(metrics);
+                if (auto_adjust) changed = exposure_model ? convergeExposure() : adjustExposure(metrics);
         } else {
             cout << "   ⚠️ Frame capture failed" << std::endl;
         }      
@@ -517,31 +606,42 @@ using namespace std;
         params["brightness"] = metrics.brightness;
         params["contrast"] = metrics.contrast;
         params["exposure"] = metrics.exposure_score; 
-        params["snapshot"] = host + snapshot + ".JPG";
+        params["snapshot"] = host + someFFMpeg::renditionPath(snapshot, preview);
+        for (auto& rendition : renditions)
+            if (rendition.width == 0 && preview.width != 0 && !(store && rendition.name == store_rendition))
+                params["snapshot_full"] = host + someFFMpeg::renditionPath(snapshot, rendition);
 
         if (settings.iso != iso) params["frame_iso"] = iso;
         if (settings.iris != iris) params["frame_iris"] = iris;
 
-        ofstream statusLog(snapshot + ".json");
-        if (statusLog.is_open()) {
-            statusLog << params.dump(4); // The 4 creates an indentation of 4 spaces
-            statusLog.close();
-        }    
+        params.update(pipeline->status());
+        if (analyzer) params.update(analysis.toJson());
+        if (exposure_model) params.update(exposure_model->status());
+        if (store) params.update(store->status());
 
-        someNetwork net;
-        net.https_request(server, "/api/caminfo", http::verb::post, params);
+        // Process-wide stage latencies - in "all" mode every camera reports the shared numbers
+        params["timing"] = someMetrics::snapshot();
 
-        cleanup();
+        // Queued, the uploader writes snapshot.json and posts in the background so a slow server never stalls the loop
+        uploader->post("/api/caminfo", params, snapshot + ".json");
+
+        if (!persistent) zcam->closeStream();
 
         return changed;
 
     }
 
+    // One monitoring pass, returns the number of seconds until the next one is due
+    int ZCAMController::cycle() {
+        if (persistent && isOperatingHours()) {
+            monitorCam();
+            return interval;
+        }
+        return monitorCam() ? 60 : 60 * refresh;
+    }
+
     void ZCAMController::run() {
         while (!stop) {
-            if (monitorCam())
-                std::this_thread::sleep_for(std::chrono::seconds(60)); 
-            else             
-                std::this_thread::sleep_for(std::chrono::seconds(60 * refresh));             
+            std::this_thread::sleep_for(std::chrono::seconds(cycle()));
         }
     }
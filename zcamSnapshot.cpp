@@ -2,71 +2,400 @@
 #include <iomanip>
 
 #include <someFFMpeg.h>
-#include <focus.h>
+#include <someNetwork.h>
+#include <someLogger.h>
+#include <someThreadPool.h>
 
-ZCAMSnapshot::ZCAMSnapshot(json config) {
+#include <deque>
+#include <condition_variable>
+
+namespace {
+
+// Encoders shared by every camera's bursts
+someThreadPool& encoders() {
+	static someThreadPool pool;
+	return pool;
+}
+
+struct EncodedFrame {
+	int index;
+	uint64_t time;
+	vector<uint8_t> jpeg;
+};
+
+// Encoded frames in completion order; pop() ends once capture finished and every encode came back.
+// The encode tasks hold a reference to it, so its owner must drain() before it goes out of scope.
+class EncodedQueue {
+	mutex queue_mutex;
+	condition_variable queue_cv;
+	deque<EncodedFrame> ready;
+	int pending = 0;
+	bool capturing = true;
+	bool uploading = true;
+public:
+	void expect() {
+		lock_guard<mutex> lock(queue_mutex);
+		pending++;
+	}
+	void push(EncodedFrame&& frame, bool ok) {
+		{
+			lock_guard<mutex> lock(queue_mutex);
+			if (ok && uploading) ready.push_back(std::move(frame));
+			pending--;
+		}
+		queue_cv.notify_all();
+	}
+	void done() {
+		{
+			lock_guard<mutex> lock(queue_mutex);
+			capturing = false;
+		}
+		queue_cv.notify_all();
+	}
+	// The upload ended, early if the request failed: later frames are dropped rather than queued
+	void close() {
+		lock_guard<mutex> lock(queue_mutex);
+		uploading = false;
+		ready.clear();
+	}
+	bool open() {
+		lock_guard<mutex> lock(queue_mutex);
+		return uploading;
+	}
+	// Blocks until every expected frame was pushed
+	void drain() {
+		unique_lock<mutex> lock(queue_mutex);
+		queue_cv.wait(lock, [this] { return pending == 0; });
+	}
+	bool pop(EncodedFrame& frame) {
+		unique_lock<mutex> lock(queue_mutex);
+		queue_cv.wait(lock, [this] { return !ready.empty() || (!capturing && pending == 0); });
+		if (ready.empty()) return false;
+		frame = std::move(ready.front());
+		ready.pop_front();
+		return true;
+	}
+};
+
+// multipart/form-data body generated part by part as frames finish encoding
+someNetwork::Response uploadFrames(const string& server, const string& url, const string& camera, EncodedQueue& queue, int& sent) {
+
+	const string boundary = "zcamframe" + to_string(someLogger::timeSinceEpochMilli());
+	bool closed = false;
+	sent = 0;
+
+	someNetwork net;
+	return net.https_stream(server, url, http::verb::post, "multipart/form-data; boundary=" + boundary,
+		[&](string& chunk) {
+			if (closed) return false;
+			EncodedFrame frame;
+			if (!queue.pop(frame)) {
+				chunk = "--" + boundary + "--\r\n";
+				closed = true;
+				return true;
+			}
+			string name = camera + "_" + to_string(frame.time) + "_" + to_string(frame.index) + ".jpg";
+			chunk = "--" + boundary + "\r\n"
+				"Content-Disposition: form-data; name=\"frame\"; filename=\"" + name + "\"\r\n"
+				"Content-Type: image/jpeg\r\n"
+				"X-Frame-Index: " + to_string(frame.index) + "\r\n"
+				"X-Frame-Time: " + to_string(frame.time) + "\r\n\r\n";
+			chunk.append(frame.jpeg.begin(), frame.jpeg.end());
+			chunk += "\r\n";
+			sent++;
+			return true;
+		});
+}
+
+}
+
+ZCAMSnapshot::ZCAMSnapshot(json config, ZCAM *source) {
 
 	this->config = config;
 	root = config["files"].get<string>();
 	cam_idx = stoi(config["cam_id"].get<string>());
     cam_name = config["cameras"][cam_idx].get<string>();
 
-	overlayProcessor = make_unique<FrameOverlayProcessor>(1920, 1080, AV_PIX_FMT_YUVJ420P); // TODO: Automatic
-    overlayProcessor->setFont("", 50);
-    overlayProcessor->setFontColor("0x443D24");  
+	if (config.count("focus_grid") > 0) {
+		auto jgrid = config["focus_grid"];
+		focus_grid = jgrid.is_object() || (jgrid.is_boolean() && jgrid.get<bool>());
+		if (jgrid.is_object()) {
+			grid.rows = max(1, jgrid.value("rows", 4));
+			grid.cols = max(1, jgrid.value("cols", 4));
+		}
+	}
+
+	if (config.count("top_margin")>0) grid.top_margin = config["top_margin"][cam_idx].get<int>();
+
+	renditions = someFFMpeg::renditions(config);
+
+	server = config["server"].get<string>();
+	host = config["host"].get<string>();
 
-	zcam = new ZCAM(config, cam_idx);
+	if (config.count("burst") > 0) {
+		auto jburst = config["burst"];
+		burst_url = jburst.value("url", burst_url);
+		burst_max = max(1, jburst.value("max", burst_max));
+		burst_quality = jburst.value("quality", burst_quality);
+	}
+
+	store = SnapshotStore::forCamera(config, cam_name);
+
+	shared = source != nullptr;
+	zcam = shared ? source : new ZCAM(config, cam_idx);
+}
+
+ZCAMSnapshot::~ZCAMSnapshot() {
+	stopTimelapse();
 }
 
 string ZCAMSnapshot::take() {
 
+	lock_guard<mutex> lock(take_mutex);
+
 	auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);       
     stringstream ss;
     // ss << root << "zcam/SNAP" << cam_idx << std::put_time(std::localtime(&time_t), "%H%M%S") << ".JPG";	
-    ss << root << "zcam/" << cam_name << std::put_time(std::localtime(&time_t), "%H%M") << ".JPG";
+    ss << root << "zcam/" << cam_name << std::put_time(std::localtime(&time_t), "%H%M");
 
-    if (zcam->initStream()) {
+    AVFrame *frame = nullptr;
 
-	    AVFrame *frame = zcam->getFrame();
-        someFFMpeg::saveAVFrameAsJPEG(frame, ss.str(), 100);
+    if (shared) {
+        zcam->startStream();
+        frame = zcam->latestFrame(15000);
+    }
+    else if (zcam->initStream())
+        frame = zcam->getFrame();
+
+    if (frame) {
+
+        AVFrame *snapFrame = focus_grid ? overlayGrid(frame) : nullptr;
 
-        /*
+        someFFMpeg::saveRenditions(snapFrame ? snapFrame : frame, ss.str(), renditions);
+        last_paths = json::object();
+        for (auto& rendition : renditions) last_paths[rendition.name] = someFFMpeg::renditionPath(ss.str(), rendition);
 
-	    overlayProcessor->clearGridText();
+        if (snapFrame) av_frame_free(&snapFrame);
+		zcam->releaseFrame(frame);
+
+	    if (!shared) zcam->closeStream();    	
+	    return someFFMpeg::renditionPath(ss.str(), renditions.front());
+    }
 
-	    int top_margin = 0;
-	    if (config.count("top_margin")>0) top_margin = config["top_margin"][cam_idx].get<int>();
+    if (!shared) zcam->closeStream();
 
-        auto dw = frame->width / 4;
-        auto dh = (frame->height - top_margin) / 4;
-        
-        for (int i = 0; i < 4; i++)
-        	for (int j = 0; j< 4; j++) {
-                int x0 = static_cast<int>(i * dw);
-                int y0 = static_cast<int>(top_margin + j * dh);
-                int x1 = static_cast<int>(i * dw + dw);
-                int y1 = static_cast<int>(top_margin + j * dh + dh);
-        	double focus = Focus::fastROI(frame, x0, y0, x1, y1);
-            string text = to_string(static_cast<int>(focus));
-            overlayProcessor->setGridText({x0 + 10, y0 + 10, focus, text});
-        }
+    return ""; // ERROR
 
-        overlayProcessor->initializeFilterGraph();
+}
 
-        AVFrame* snapFrame = overlayProcessor->processFrame(frame);
+json ZCAMSnapshot::lastPaths() {
+	lock_guard<mutex> lock(take_mutex);
+	return last_paths;
+}
 
-        */
+// Sharpness of every grid cell written at the cell's corner; nullptr when the overlay fails
+AVFrame* ZCAMSnapshot::overlayGrid(AVFrame *frame) {
 
-		av_frame_free(&frame);
+	// Sized from the stream itself, rebuilt if the decoder output changes format
+	if (!overlayProcessor || overlay_format != frame->format) {
+		overlayProcessor = make_unique<FrameOverlayProcessor>(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format));
+	    overlayProcessor->setFont("", 50);
+	    overlayProcessor->setFontColor("0x443D24");
+	    overlay_format = frame->format;
+	}
 
-        // someFFMpeg::saveAVFrameAsJPEG(snapFrame, ss.str(), 100);
-        // av_frame_free(&snapFrame);
+	// All cells from one pass over the Y plane
+	auto cells = Focus::grid(frame, grid);
 
-	    zcam->closeStream();    	
-	    return ss.str();
-    }
+	overlayProcessor->clearGridText();
 
-    return ""; // ERROR
+	int top_margin = max(0, min(grid.top_margin, frame->height));
+	int dw = frame->width / grid.cols;
+	int dh = (frame->height - top_margin) / grid.rows;
+
+	for (int r = 0; r < grid.rows; r++)
+		for (int c = 0; c < grid.cols; c++) {
+			double focus = cells[r * grid.cols + c];
+			string text = to_string(static_cast<int>(focus));
+			overlayProcessor->setGridText({c * dw + 10, top_margin + r * dh + 10, focus, text});
+		}
+
+	// Drawn natively on a private copy of the frame, no filter graph involved
+	AVFrame *snapFrame = av_frame_clone(frame);
+	if (!snapFrame) return nullptr;
+	if (!overlayProcessor->compositeFrame(snapFrame)) av_frame_free(&snapFrame);
+
+	return snapFrame;
+}
+
+// params: count, interval_ms, quality
+json ZCAMSnapshot::burst(const json& params) {
+
+	int count = min(burst_max, max(1, params.value("count", 10)));
+	int interval_ms = max(0, params.value("interval_ms", 200));
+	int quality = params.value("quality", burst_quality);
+
+	return series(count, interval_ms, quality, "burst");
+}
+
+// Frames are captured on this thread, encoded on the shared pool and uploaded on another thread while
+// the next ones are still coming, so throughput is set by the decoder rather than by round trips
+json ZCAMSnapshot::series(int count, int interval_ms, int quality, const string& mode) {
+
+	// A private session can only feed one series at a time; the shared ring serves any number
+	unique_lock<mutex> lock(take_mutex, defer_lock);
+	if (!shared) lock.lock();
 
-}
\ No newline at end of file
+	EncodedQueue queue;
+	int sent = 0;
+	string url = burst_url + "?camera=" + cam_name + "&host=" + someNetwork::urlencode(host) + "&mode=" + mode;
+
+	someNetwork::Response response;
+	thread uploader([&]() {
+		response = uploadFrames(server, url, cam_name, queue, sent);
+		queue.close();
+	});
+
+	bool ready = shared ? zcam->startStream() : zcam->initStream();
+	uint64_t seq = 0;
+	int captured = 0;
+	auto due = chrono::steady_clock::now();
+
+	for (int i = 0; ready && i < count && queue.open(); i++) {
+
+		this_thread::sleep_until(due);
+		due += chrono::milliseconds(interval_ms);
+
+		AVFrame *frame = shared ? zcam->waitFrame(seq) : zcam->getFrame();
+		if (!frame) break;
+
+		uint64_t time = someLogger::timeSinceEpochMilli();
+		queue.expect();
+		captured++;
+		encoders().post([this, &queue, frame, i, time, quality]() {
+			EncodedFrame encoded{i, time, {}};
+			bool ok = someFFMpeg::encodeJPEG(frame, quality, encoded.jpeg);
+			zcam->releaseFrame(frame);
+			queue.push(std::move(encoded), ok);
+		});
+	}
+
+	queue.done();
+	uploader.join();
+
+	// An upload that gave up early leaves encodes in flight, they release frames of this stream
+	queue.drain();
+	if (!shared) zcam->closeStream();
+
+	json result;
+	result["mode"] = mode;
+	result["captured"] = captured;
+	result["uploaded"] = sent;
+	result["status"] = response.status;
+	if (!response.json.is_null()) result["server"] = response.json;
+	return result;
+}
+
+// params: interval (seconds), count (0 = until timelapse_stop), quality
+json ZCAMSnapshot::timelapse(const json& params) {
+
+	int interval_s = max(1, params.value("interval", 60));
+	int count = max(0, params.value("count", 0));
+	int quality = params.value("quality", burst_quality);
+
+	{
+		lock_guard<mutex> lock(timelapse_mutex);
+		joinTimelapse();
+		timelapse_running = true;
+		timelapse_thread = thread(&ZCAMSnapshot::timelapseLoop, this, count, interval_s, quality);
+	}
+
+	json result;
+	result["mode"] = "timelapse";
+	result["interval"] = interval_s;
+	result["count"] = count;
+	return result;
+}
+
+void ZCAMSnapshot::stopTimelapse() {
+	lock_guard<mutex> lock(timelapse_mutex);
+	joinTimelapse();
+}
+
+void ZCAMSnapshot::joinTimelapse() {
+	timelapse_running = false;
+	if (timelapse_thread.joinable()) timelapse_thread.join();
+}
+
+void ZCAMSnapshot::timelapseLoop(int count, int interval_s, int quality) {
+
+	auto due = chrono::steady_clock::now();
+
+	for (int i = 0; timelapse_running && (count == 0 || i < count); i++) {
+
+		// One-frame series per tick - an hours-long chunked request would not survive a network blip
+		auto result = series(1, 0, quality, "timelapse");
+		if (result["uploaded"].get<int>() == 0)
+			someLogger::getInstance()->log(cam_name + " timelapse frame " + to_string(i) + " failed: " + result.dump());
+
+		due += chrono::seconds(interval_s);
+		while (timelapse_running && chrono::steady_clock::now() < due)
+			this_thread::sleep_for(chrono::milliseconds(200));
+	}
+
+	timelapse_running = false;
+}
+
+// params: from, to (ms since epoch, default the last hour), limit
+json ZCAMSnapshot::history(const json& params) {
+
+	json result;
+	result["frames"] = json::array();
+	if (!store) return result;
+
+	int64_t to = params.value("to", static_cast<int64_t>(someLogger::timeSinceEpochMilli()));
+	int64_t from = params.value("from", to - 3600000);
+	auto entries = store->query(from, to, static_cast<size_t>(max(1, params.value("limit", 1000))));
+
+	for (auto& entry : entries) result["frames"].push_back(SnapshotStore::toJson(entry));
+	return result;
+}
+
+json ZCAMSnapshot::fetch(const json& params) {
+
+	json result;
+	if (!store) return result;
+
+	int64_t to = params.value("to", static_cast<int64_t>(someLogger::timeSinceEpochMilli()));
+	int64_t from = params.value("from", to - 3600000);
+	auto entries = store->query(from, to, static_cast<size_t>(min(burst_max, max(1, params.value("limit", burst_max)))));
+
+	EncodedQueue queue;
+	int sent = 0;
+	string url = burst_url + "?camera=" + cam_name + "&host=" + someNetwork::urlencode(host) + "&mode=stored";
+
+	someNetwork::Response response;
+	thread uploader([&]() {
+		response = uploadFrames(server, url, cam_name, queue, sent);
+		queue.close();
+	});
+
+	// Reads are sequential within a day segment, one at a time keeps memory flat
+	for (size_t i = 0; i < entries.size() && queue.open(); i++) {
+		EncodedFrame frame{static_cast<int>(i), static_cast<uint64_t>(entries[i].time), {}};
+		queue.expect();
+		bool ok = store->read(entries[i], frame.jpeg);
+		queue.push(std::move(frame), ok);
+	}
+
+	queue.done();
+	uploader.join();
+
+	result["mode"] = "stored";
+	result["found"] = entries.size();
+	result["uploaded"] = sent;
+	result["status"] = response.status;
+	if (!response.json.is_null()) result["server"] = response.json;
+	return result;
+}